@@ -0,0 +1,81 @@
+/**
+ * Measures sphere vs frustum culling of sprites with each kernel, which writes the visible sprites to a separate buffer
+ * the way the renderer writes them to the mapped instance buffer.
+ * Sprites are scattered around the camera so that roughly a fifth of them are visible. Fails if the SIMD kernels
+ * disagree with the scalar one.
+ */
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "graphics/culling.h"
+#include "graphics/sprite.h"
+#include "math/basic.h"
+#include "util/clock.h"
+#include "util/cpu.h"
+#include "util/logging.h"
+
+namespace {
+
+std::size_t measure (const char* label, graphics::culling::cull_fn cull, const math::frustum& frustum, const std::vector<graphics::Sprite>& sprites, std::vector<graphics::Sprite>& out, std::size_t frames)
+{
+    std::vector<float> samples;
+    samples.reserve(frames);
+    std::size_t kept = 0;
+    for (std::size_t i = 0; i < frames; ++i) {
+        auto start = Clock::now();
+        kept = cull(&frustum.planes[0].x, 1.0f, &sprites[0].position.x, sprites.size(), &out[0].position.x);
+        samples.push_back(std::chrono::duration_cast<DeltaTime>(Clock::now() - start).count() * 1000.0f);
+    }
+    std::sort(samples.begin(), samples.end());
+    info("  {}: min {:.3f} ms, median {:.3f} ms, p99 {:.3f} ms, max {:.3f} ms, {} visible", label,
+         samples.front(), samples[samples.size() / 2], samples[(samples.size() * 99) / 100], samples.back(), kept);
+    return kept;
+}
+
+}
+
+int main (int argc, char* argv[])
+{
+    logging::init("info");
+    const std::size_t frames = 200;
+    const std::size_t count = 100000;
+
+    const glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+    const glm::mat4 view = glm::lookAt(glm::vec3(0, 10, 10), glm::vec3(0, 0, -20), glm::vec3(0, 1, 0));
+    const math::frustum frustum(projection * view);
+
+    std::mt19937 mt(0);
+    std::uniform_real_distribution<float> dist(-100.0f, 100.0f);
+    std::vector<graphics::Sprite> sprites(count);
+    for (auto& sprite : sprites) {
+        sprite.position = glm::vec3(dist(mt), dist(mt) * 0.1f, dist(mt));
+        sprite.image = 0.0f;
+    }
+
+    info("{} sprites", count);
+    std::vector<graphics::Sprite> expected(count);
+    std::vector<graphics::Sprite> visible(count);
+    const auto expected_count = measure("scalar", graphics::culling::cull_scalar, frustum, sprites, expected, frames);
+    struct Kernel {
+        const char* label;
+        graphics::culling::cull_fn cull;
+        bool supported;
+    };
+    for (const auto& kernel : {Kernel{"sse4.1", graphics::culling::cull_sse41, cpu::hasSSE41()}, Kernel{"avx2", graphics::culling::cull_avx2, cpu::hasAVX2()}}) {
+        if (! kernel.supported) {
+            info("  {}: not supported by this CPU", kernel.label);
+            continue;
+        }
+        const auto visible_count = measure(kernel.label, kernel.cull, frustum, sprites, visible, frames);
+        if (visible_count != expected_count || std::memcmp(visible.data(), expected.data(), sizeof(graphics::Sprite) * visible_count) != 0) {
+            error("{} kernel disagrees with the scalar kernel", kernel.label);
+            return 1;
+        }
+    }
+    logging::term();
+    return 0;
+}
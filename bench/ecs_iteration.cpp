@@ -0,0 +1,89 @@
+/**
+ * Compares iterating a pair of components through a view, a non-owning group and an owning group.
+ * Half of the entities carrying the first component lack the second, so the view has to reject them one by one while
+ * the groups only ever visit matching entities.
+ */
+#include <algorithm>
+#include <vector>
+
+#include "ecs/system.h"
+#include "util/clock.h"
+#include "util/logging.h"
+
+namespace {
+
+struct position {
+    float x, y, z;
+};
+
+struct velocity {
+    float x, y, z;
+};
+
+template <typename This>
+class integrate : public ecs::base_system<This, position, velocity> {
+public:
+    void update (ecs::entity, position& p, const velocity& v) {
+        p.x += v.x;
+        p.y += v.y;
+        p.z += v.z;
+    }
+};
+
+class view_system : public integrate<view_system> {
+public:
+    using storage = ecs::view_storage;
+};
+
+class non_owning_system : public integrate<non_owning_system> {
+public:
+    using storage = ecs::group_storage<>;
+};
+
+class owning_system : public integrate<owning_system> {
+public:
+    using storage = ecs::group_storage<position, velocity>;
+};
+
+template <typename System>
+void measure (const char* label, std::size_t population, std::size_t frames)
+{
+    ecs::registry_type registry;
+    for (std::size_t i = 0; i < population; ++i) {
+        auto entity = registry.create();
+        registry.assign<position>(entity, 0.0f, 0.0f, 0.0f);
+        if (i % 2 == 0) {
+            registry.assign<velocity>(entity, 1.0f, 2.0f, 3.0f);
+        }
+    }
+    System system;
+    system.prepare(registry);
+    system.run(registry);
+
+    std::vector<float> samples;
+    samples.reserve(frames);
+    for (std::size_t i = 0; i < frames; ++i) {
+        auto start = Clock::now();
+        system.run(registry);
+        samples.push_back(std::chrono::duration_cast<DeltaTime>(Clock::now() - start).count() * 1000.0f);
+    }
+    std::sort(samples.begin(), samples.end());
+    info("  {}: min {:.3f} ms, median {:.3f} ms, p99 {:.3f} ms, max {:.3f} ms", label,
+         samples.front(), samples[samples.size() / 2], samples[(samples.size() * 99) / 100], samples.back());
+}
+
+}
+
+int main (int argc, char* argv[])
+{
+    logging::init("info");
+    const std::size_t frames = 100;
+    for (std::size_t population : {std::size_t(10000), std::size_t(100000), std::size_t(1000000)}) {
+        info("{} entities, {} with both components", population, population / 2);
+        measure<view_system>("view", population, frames);
+        measure<non_owning_system>("non-owning group", population, frames);
+        measure<owning_system>("owning group", population, frames);
+    }
+    logging::term();
+    return 0;
+}
@@ -0,0 +1,97 @@
+/**
+ * Measures the per-frame cost of base_system entity tracking.
+ * With a stable population, frame time should not depend on how many entities the system is tracking beyond the
+ * cost of iterating them, and adding or removing a handful of entities should cost next to nothing.
+ * In debug builds this also fails if the system allocates while the population is stable.
+ */
+#include <algorithm>
+#include <vector>
+
+#include "ecs/system.h"
+#include "util/clock.h"
+#include "util/logging.h"
+
+namespace {
+
+struct tracked {
+    float value;
+};
+
+class tracking_system : public ecs::base_system<tracking_system, tracked> {
+public:
+    std::size_t live = 0;
+
+    void update (ecs::entity, tracked& t) {
+        t.value += 1.0f;
+    }
+
+    void notify (ecs::registry_type&, ecs::EntityNotification notification, const std::vector<ecs::entity>& entities) {
+        if (notification == ecs::EntityNotification::ADDED) {
+            live += entities.size();
+        } else {
+            live -= entities.size();
+        }
+    }
+};
+
+template <typename Fn>
+void measure (const char* label, std::size_t frames, Fn&& frame)
+{
+    std::vector<float> samples;
+    samples.reserve(frames);
+    for (std::size_t i = 0; i < frames; ++i) {
+        auto start = Clock::now();
+        frame(i);
+        samples.push_back(std::chrono::duration_cast<DeltaTime>(Clock::now() - start).count() * 1000.0f);
+    }
+    std::sort(samples.begin(), samples.end());
+    info("{}: min {:.3f} ms, median {:.3f} ms, p99 {:.3f} ms, max {:.3f} ms", label,
+         samples.front(), samples[samples.size() / 2], samples[(samples.size() * 99) / 100], samples.back());
+}
+
+}
+
+int main (int argc, char* argv[])
+{
+    logging::init("info");
+    const std::size_t frames = 200;
+    for (std::size_t population : {std::size_t(10000), std::size_t(100000), std::size_t(1000000)}) {
+        ecs::registry_type registry;
+        std::vector<ecs::entity> entities;
+        entities.reserve(population);
+        for (std::size_t i = 0; i < population; ++i) {
+            auto entity = registry.create();
+            registry.assign<tracked>(entity, 0.0f);
+            entities.push_back(entity);
+        }
+        tracking_system system;
+        // The first run reports every existing entity as added
+        system.run(registry);
+        info("{} entities tracked", system.live);
+
+        measure("  stable population", frames, [&](std::size_t){
+            system.run(registry);
+        });
+
+        if (ecs::steady_state_allocations() > 0) {
+            error("System allocated {} times with a stable population", ecs::steady_state_allocations().load());
+            return 1;
+        }
+
+        measure("  10 added + 10 removed per frame", frames, [&](std::size_t frame){
+            for (std::size_t i = 0; i < 10; ++i) {
+                auto& entity = entities[(frame * 10 + i) % population];
+                registry.destroy(entity);
+                entity = registry.create();
+                registry.assign<tracked>(entity, 0.0f);
+            }
+            system.run(registry);
+        });
+        if (system.live != population) {
+            error("Tracking mismatch: {} live, expected {}", system.live, population);
+            return 1;
+        }
+    }
+    logging::term();
+    return 0;
+}
@@ -0,0 +1,102 @@
+/**
+ * Measures one kinematic integration step with each kernel, running straight over position and kinematic_body
+ * component storage the way kinematic_integration does.
+ * Bodies start scattered inside the bounds with random velocities, so some of them bounce every step. Fails if the SIMD
+ * kernels disagree with the scalar one, or touch the previous position that follows each position's x, y and z.
+ */
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "ecs/components/kinematic_body.h"
+#include "ecs/components/position.h"
+#include "ecs/systems/kinematic_integration_kernels.h"
+#include "util/clock.h"
+#include "util/cpu.h"
+#include "util/logging.h"
+
+namespace {
+
+using ecs::components::kinematic_body;
+using ecs::components::position;
+using ecs::systems::kernels::integrate_fn;
+using ecs::systems::kernels::kinematic_step;
+
+struct State {
+    std::vector<kinematic_body> bodies;
+    std::vector<position> positions;
+};
+
+void measure (const char* label, integrate_fn integrate, const kinematic_step& step, State& state, std::size_t frames)
+{
+    std::vector<float> samples;
+    samples.reserve(frames);
+    for (std::size_t i = 0; i < frames; ++i) {
+        auto start = Clock::now();
+        integrate(step,
+                  &state.bodies[0].velocity.x, sizeof(kinematic_body) / sizeof(float),
+                  &state.positions[0].position.x, sizeof(position) / sizeof(float),
+                  state.bodies.size());
+        samples.push_back(std::chrono::duration_cast<DeltaTime>(Clock::now() - start).count() * 1000.0f);
+    }
+    std::sort(samples.begin(), samples.end());
+    info("  {}: min {:.3f} ms, median {:.3f} ms, p99 {:.3f} ms, max {:.3f} ms", label,
+         samples.front(), samples[samples.size() / 2], samples[(samples.size() * 99) / 100], samples.back());
+}
+
+float difference (const glm::vec3& a, const glm::vec3& b)
+{
+    return std::max({std::fabs(a.x - b.x), std::fabs(a.y - b.y), std::fabs(a.z - b.z)});
+}
+
+}
+
+int main (int argc, char* argv[])
+{
+    logging::init("info");
+    const std::size_t frames = 200;
+    // Kernels may contract multiplies and adds differently, so results are compared with some tolerance
+    const float tolerance = 0.01f;
+    const kinematic_step step{1.0f / 60.0f, -10.0f, 0.0f, -100.0f, 100.0f, -100.0f, 100.0f};
+
+    // Odd sizes, so that the SIMD kernels also hand a remainder to the scalar kernel
+    for (std::size_t count : {std::size_t(10001), std::size_t(100003), std::size_t(1000005)}) {
+        std::mt19937 mt(0);
+        std::uniform_real_distribution<float> dist(-100.0f, 100.0f);
+        State initial{std::vector<kinematic_body>(count), std::vector<position>(count)};
+        for (std::size_t i = 0; i < count; ++i) {
+            initial.bodies[i].velocity = glm::vec3(dist(mt), dist(mt) * 0.1f, dist(mt));
+            initial.bodies[i].restitution = 0.5f;
+            initial.positions[i].position = glm::vec3(dist(mt), std::fabs(dist(mt)), dist(mt));
+            initial.positions[i].previous = glm::vec3(float(i));
+        }
+
+        info("{} bodies", count);
+        State expected = initial;
+        measure("scalar", ecs::systems::kernels::integrate_scalar, step, expected, frames);
+        struct Kernel {
+            const char* label;
+            integrate_fn integrate;
+            bool supported;
+        };
+        for (const auto& kernel : {Kernel{"sse4.1", ecs::systems::kernels::integrate_sse41, cpu::hasSSE41()}, Kernel{"avx2", ecs::systems::kernels::integrate_avx2, cpu::hasAVX2()}}) {
+            if (! kernel.supported) {
+                info("  {}: not supported by this CPU", kernel.label);
+                continue;
+            }
+            State state = initial;
+            measure(kernel.label, kernel.integrate, step, state, frames);
+            for (std::size_t i = 0; i < count; ++i) {
+                if (difference(state.positions[i].position, expected.positions[i].position) > tolerance ||
+                    difference(state.bodies[i].velocity, expected.bodies[i].velocity) > tolerance ||
+                    state.positions[i].previous != initial.positions[i].previous) {
+                    error("{} kernel disagrees with the scalar kernel for body {}", kernel.label, i);
+                    return 1;
+                }
+            }
+        }
+    }
+    logging::term();
+    return 0;
+}
@@ -0,0 +1,145 @@
+/**
+ * Measures physics::Engine step times for different body layouts and broadphases.
+ * Usage: bench_physics [bodies] [steps] [layout] [broadphase], where layout is pile, field or grid and broadphase is
+ * dbvt, axis-sweep or axis-sweep-32. Without a layout or broadphase, every combination is run.
+ *
+ *   pile:  bodies dropped in a tall column, so they fall and come to rest on top of each other
+ *   field: bodies spread far apart on the ground, where most of them quickly fall asleep
+ *   grid:  bodies packed into a cube just touching each other, which keeps the narrowphase and solver busy
+ */
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "physics/engine.h"
+#include "services/locator.h"
+#include "util/clock.h"
+#include "util/logging.h"
+
+namespace {
+
+enum class Layout { Pile, Field, Grid };
+constexpr Layout Layouts[] = {Layout::Pile, Layout::Field, Layout::Grid};
+constexpr physics::Broadphase Broadphases[] = {physics::Broadphase::Dbvt, physics::Broadphase::AxisSweep, physics::Broadphase::AxisSweep32};
+
+const char* layoutName (Layout layout)
+{
+    switch (layout) {
+        case Layout::Pile: return "pile";
+        case Layout::Field: return "field";
+        case Layout::Grid: return "grid";
+    }
+    return "unknown";
+}
+
+// Positions for count unit cubes (half extents of 0.5) resting above the ground at y = 0
+std::vector<glm::vec3> generate (Layout layout, std::size_t count)
+{
+    std::vector<glm::vec3> positions;
+    positions.reserve(count);
+    const auto side = std::size_t(std::ceil(std::sqrt(double(count))));
+    const auto cube = std::size_t(std::ceil(std::cbrt(double(count))));
+    for (std::size_t index = 0; index < count; ++index) {
+        switch (layout) {
+            case Layout::Pile: {
+                // Columns of 100, slightly offset so the pile topples
+                const float x = float(index / 100) * 1.5f;
+                const float y = 1.0f + float(index % 100) * 1.2f;
+                positions.push_back({x + float(index % 3) * 0.1f, y, 0.0f});
+                break;
+            }
+            case Layout::Field:
+                positions.push_back({float(index % side) * 10.0f, 0.5f, float(index / side) * 10.0f});
+                break;
+            case Layout::Grid:
+                positions.push_back({float(index % cube), 0.5f + float((index / cube) % cube), float(index / (cube * cube))});
+                break;
+        }
+    }
+    return positions;
+}
+
+void measure (Layout layout, physics::Broadphase broadphase, std::size_t count, std::size_t steps)
+{
+    if (broadphase == physics::Broadphase::AxisSweep && count + 1 > 16383) {
+        info("  {:<6} {:<14} skipped, too many bodies", layoutName(layout), physics::broadphaseName(broadphase));
+        return;
+    }
+    const auto positions = generate(layout, count);
+    float extent = 100.0f;
+    for (const auto& position : positions) {
+        extent = std::max({extent, std::abs(position.x), std::abs(position.y), std::abs(position.z)});
+    }
+    services::locator::config<"physics.broadphase"_hs, int>(int(broadphase));
+    services::locator::config<"physics.world-size"_hs, float>(extent + 100.0f);
+
+    physics::Engine engine;
+    engine.init();
+
+    // Entities are only used as keys by the engine, so make them up
+    std::vector<ecs::entity> entities;
+    std::vector<services::Physics::Body> bodies;
+    std::vector<services::Physics::Shape> shapes;
+    entities.push_back(ecs::entity(0));
+    bodies.push_back({glm::vec3(0, -1.0f, 0), 0.0f, 0.5f, 0.0f});
+    shapes.push_back({glm::vec3(extent + 50.0f, 1.0f, extent + 50.0f)});
+    for (std::size_t index = 0; index < count; ++index) {
+        entities.push_back(ecs::entity(index + 1));
+        bodies.push_back({positions[index], 1.0f, 0.5f, 0.0f});
+        shapes.push_back({glm::vec3(0.5f)});
+    }
+    engine.addBodies(entities, bodies, shapes);
+
+    const float step_length = 1.0f / 60.0f;
+    std::vector<float> samples;
+    samples.reserve(steps);
+    for (std::size_t step = 0; step < steps; ++step) {
+        auto start = Clock::now();
+        engine.stepSimulation(step_length);
+        samples.push_back(std::chrono::duration_cast<DeltaTime>(Clock::now() - start).count() * 1000.0f);
+    }
+    const auto moved = engine.movedBodies().entities.size();
+    engine.term();
+
+    std::sort(samples.begin(), samples.end());
+    info("  {:<6} {:<14} min {:.3f} ms, median {:.3f} ms, p90 {:.3f} ms, p99 {:.3f} ms, max {:.3f} ms, {} awake at the end",
+         layoutName(layout), physics::broadphaseName(broadphase), samples.front(), samples[samples.size() / 2],
+         samples[(samples.size() * 90) / 100], samples[(samples.size() * 99) / 100], samples.back(), moved);
+}
+
+}
+
+int main (int argc, char* argv[])
+{
+    logging::init("info");
+    const std::size_t count = argc > 1 ? std::size_t(std::atoll(argv[1])) : 10000;
+    const std::size_t steps = argc > 2 ? std::size_t(std::atoll(argv[2])) : 300;
+    const std::string only_layout = argc > 3 ? argv[3] : "";
+    const std::string only_broadphase = argc > 4 ? argv[4] : "";
+    if (count == 0 || steps == 0) {
+        error("Usage: {} [bodies] [steps] [pile|field|grid] [dbvt|axis-sweep|axis-sweep-32]", argv[0]);
+        return 1;
+    }
+
+    // Single threaded, stepping at the tick rate
+    services::locator::config<"physics.threads"_hs, int>(1);
+    services::locator::config<"physics.rate"_hs, float>(60.0f);
+    services::locator::config<"physics.max-substeps"_hs, int>(1);
+
+    info("{} bodies, {} steps", count, steps);
+    for (auto layout : Layouts) {
+        if (! only_layout.empty() && only_layout != layoutName(layout)) {
+            continue;
+        }
+        for (auto broadphase : Broadphases) {
+            if (! only_broadphase.empty() && only_broadphase != physics::broadphaseName(broadphase)) {
+                continue;
+            }
+            measure(layout, broadphase, count, steps);
+        }
+    }
+    logging::term();
+    return 0;
+}
@@ -19,41 +19,26 @@ out VertexData {
 	flat int image;
 } vertex;
 
+// One RGBA texel per instance: position in xyz and image index in w, either as 32 or 16 bit floats
 uniform samplerBuffer u_tbo_tex;
+// Index of the first instance within u_tbo_tex, for instances that share a buffer with others
+uniform int u_first_instance;
 
 void main() {
-	int offset = gl_InstanceID * 4;
-    vec3 instance_pos = vec3(texelFetch(u_tbo_tex, offset).r,
-						     texelFetch(u_tbo_tex, offset + 1).r,
-					  	     texelFetch(u_tbo_tex, offset + 2).r);
-	vertex.image = int(texelFetch(u_tbo_tex, offset + 3).r);
-	vec3 position = in_Position + instance_pos;
-
-	mat4 model = mat4(1.0);
-	model[3][0] = instance_pos.x;
-	model[3][1] = instance_pos.y;
-	model[3][2] = instance_pos.z;
-	mat4 modelView = view * model;
+	vec4 instance = texelFetch(u_tbo_tex, u_first_instance + gl_InstanceID);
+	vertex.image = int(instance.w);
 
+	// Billboarding keeps the quad facing the camera by offsetting its vertices in view space, around the view space
+	// position of the instance. Cylindrical billboards keep their up axis, spherical ones are fully camera aligned.
+	vec3 center = (view * vec4(instance.xyz, 1.0)).xyz;
+	vec3 view_position;
 	if (billboarding) {
-		modelView[0][0] = 1.0; 
-		modelView[0][1] = 0.0; 
-		modelView[0][2] = 0.0; 
-
-		if (spherical_billboarding) {
-			// Second colunm.
-			modelView[1][0] = 0.0; 
-			modelView[1][1] = 1.0; 
-			modelView[1][2] = 0.0; 
-		}
-
-		// Thrid colunm.
-		modelView[2][0] = 0.0; 
-		modelView[2][1] = 0.0; 
-		modelView[2][2] = 1.0; 
+		vec3 up = spherical_billboarding ? vec3(0.0, 1.0, 0.0) : view[1].xyz;
+		view_position = center + vec3(in_Position.x, 0.0, in_Position.z) + up * in_Position.y;
+	} else {
+		view_position = center + mat3(view) * in_Position;
 	}
 
-
-	gl_Position = projection * modelView * vec4(in_Position, 1.0);
+	gl_Position = projection * vec4(view_position, 1.0);
 	vertex.textureCoordinates = in_UV;
-}
\ No newline at end of file
+}
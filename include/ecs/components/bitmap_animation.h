@@ -1,20 +1,19 @@
 #ifndef COMPONENT_BITMAP_ANIMATION_H
 #define COMPONENT_BITMAP_ANIMATION_H
 
-#include <util/clock.h>
-
 namespace ecs::components {
 
+// All fields are floats so that the animation kernels can process many animations per instruction
 struct bitmap_animation {
     // Attributes
     float base_image;
     float max_frames;
-    float speed;
+    float speed; // seconds per frame
     // Runtime data
     float current_frame;
-    ElapsedTime_t start_time;
+    float frame_time; // seconds spent on the current frame
 };
 
 }
 
-#endif // COMPONENT_BITMAP_ANIMATION_H
\ No newline at end of file
+#endif // COMPONENT_BITMAP_ANIMATION_H
@@ -0,0 +1,17 @@
+#ifndef COMPONENT_KINEMATIC_BODY_H
+#define COMPONENT_KINEMATIC_BODY_H
+
+#include <glm/glm.hpp>
+
+namespace ecs::components {
+
+// Cheap alternative to physics_body for things that only fall, move and bounce off the level bounds, but never collide
+// with each other (particles, projectiles, ambient critters)
+struct kinematic_body {
+    glm::vec3 velocity = glm::vec3(0.0f);
+    float restitution = 0.5f; // Fraction of speed kept when bouncing off the ground or bounds
+};
+
+}
+
+#endif // COMPONENT_KINEMATIC_BODY_H
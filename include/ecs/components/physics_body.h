@@ -1,10 +1,16 @@
 #ifndef COMPONENT_PHYSICS_BODY_H
 #define COMPONENT_PHYSICS_BODY_H
 
+#include <glm/glm.hpp>
+
 namespace ecs::components {
 
+// Parameters used to create the entity's rigid body when it enters the physics simulation
 struct physics_body {
-
+    float mass = 1.0f;
+    float friction = 0.5f;
+    float restitution = 1.0f;
+    glm::vec3 half_extents = glm::vec3(0.5f, 1.0f, 0.5f);
 };
 
 }
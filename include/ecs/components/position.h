@@ -7,6 +7,7 @@ namespace ecs::components {
 
 struct position {
     glm::vec3 position;
+    glm::vec3 previous; // Position at the end of the previous simulation tick, rendering interpolates from here
 };
 
 }
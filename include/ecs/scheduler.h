@@ -0,0 +1,62 @@
+#ifndef ECS_SCHEDULER_H
+#define ECS_SCHEDULER_H
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <ecs/system.h>
+#include <jobs/scheduler.h>
+
+namespace ecs {
+
+/**
+ * Runs a set of systems once per frame, concurrently where their component access allows it.
+ * Two systems conflict if either one writes a component the other reads or writes. Conflicting systems run in the
+ * order they were added, everything else is free to run at the same time on the job scheduler's workers.
+ */
+class scheduler {
+public:
+    scheduler ();
+    ~scheduler ();
+
+    void add (system* s);
+
+    // Compute the dependency graph, called automatically by the first run() after systems were added
+    void build (registry_type& registry);
+
+    void run (registry_type& registry);
+
+    // Human readable description of the computed schedule, including why each dependency exists
+    std::string dump () const;
+
+private:
+    struct dependency {
+        std::size_t system;
+        std::string reason;
+    };
+    struct node {
+        system* instance;
+        std::string name;
+        access_set access;
+        std::vector<dependency> dependencies; // Systems that must complete before this one starts
+        std::vector<std::size_t> dependents; // Systems waiting on this one
+    };
+
+    std::vector<node> nodes;
+    std::unique_ptr<std::atomic<std::size_t>[]> remaining;
+    bool dirty;
+
+    // Per-run state, used by the jobs
+    registry_type* current_registry;
+    jobs::Scheduler* current_jobs;
+    jobs::Counter* current_counter;
+
+    void launch (std::size_t index);
+    static void execute (void* data, std::size_t index, std::size_t);
+};
+
+}
+
+#endif // ECS_SCHEDULER_H
@@ -3,23 +3,55 @@
 
 #include <vector>
 #include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <tuple>
 #include <type_traits>
+#include <typeindex>
 #include <utility>
 
 #include <ecs/types.h>
+#include <util/helpers.h>
+#include <util/allocations.h>
+#include <util/logging.h>
 
-// #include "tbb/parallel_for.h"
-// #include "tbb/blocked_range.h"
-// #include "tbb/concurrent_unordered_set.h"
-// #include "tbb/concurrent_vector.h"
+#include <services/locator.h>
+#include <jobs/scheduler.h>
 
 namespace ecs {
 
+struct component_info {
+    std::type_index type;
+    const char* name;
+};
+
+// Components (and any other declared resources) a system reads and writes while it runs.
+// Exclusive systems are never run alongside another system.
+struct access_set {
+    std::vector<component_info> reads;
+    std::vector<component_info> writes;
+    bool exclusive;
+};
+
+// Total heap allocations made by systems running in steady state, only counted in debug builds
+inline std::atomic<std::size_t>& steady_state_allocations () {
+    static std::atomic<std::size_t> total{0};
+    return total;
+}
+
 class system {
 public:
     virtual ~system () noexcept = default;
 
     virtual void run (registry_type& registry) = 0;
+
+    // Make sure any registry storage used by run() exists, so that run() never modifies the registry's pool list
+    virtual void prepare (registry_type& registry) {}
+
+    // Without more information, assume a system may touch anything
+    virtual access_set access () const { return {{}, {}, true}; }
+    virtual std::string name () const { return "system"; }
 };
 
 enum class EntityNotification {
@@ -27,6 +59,26 @@ enum class EntityNotification {
     REMOVED
 };
 
+/**
+ * How a system's components are laid out for iteration, declared in the system as
+ *     using storage = ecs::group_storage<ecs::components::a, ecs::components::b>;
+ * view_storage (the default) iterates a view, which probes every component's sparse set for each candidate entity.
+ * group_storage<Owned...> iterates a group: the owned components are packed and sorted in step with the group's
+ * entities, so they are read with a linear scan, and any other components are looked up per entity. A component can
+ * only be owned by one group, so systems sharing a component must agree on which of them owns it.
+ * group_storage<> is a non-owning group, which still keeps a packed list of exactly the entities that match.
+ */
+struct view_storage {};
+template <typename... Owned> struct group_storage {};
+
+/**
+ * Access that the scheduler can't see from update(), because it happens in pre(), post() or notify(), declared as
+ *     using reads = ecs::type_list<ecs::components::a>;
+ *     using writes = ecs::type_list<ecs::components::b, services::Renderer>;
+ * Any type can be listed, so services touched outside of update() order systems just like components do.
+ */
+template <typename... Types> struct type_list {};
+
 namespace detail {
     template<typename T> struct has_method__pre {
     private:
@@ -37,8 +89,23 @@ namespace detail {
     public:
         static constexpr bool value = std::is_same<decltype(test<T>(0)),yes>::value;
     };
-    template<typename T> typename std::enable_if<has_method__pre<T>::value, void>::type call_if_declared__pre(T* self) {self->pre();}
-    void call_if_declared__pre(...) {}
+    template<typename T> struct has_method__pre_registry {
+    private:
+        typedef std::true_type yes;
+        typedef std::false_type no;
+        template<typename U> static auto test(int) -> decltype(std::declval<U>().pre(std::declval<registry_type&>()), yes());
+        template<typename> static no test(...);
+    public:
+        static constexpr bool value = std::is_same<decltype(test<T>(0)),yes>::value;
+    };
+    // pre() may optionally take the registry
+    template<typename T> void call_if_declared__pre(T* self, registry_type& registry) {
+        if constexpr (has_method__pre_registry<T>::value) {
+            self->pre(registry);
+        } else if constexpr (has_method__pre<T>::value) {
+            self->pre();
+        }
+    }
 
     template<typename T> struct has_method__post {
     private:
@@ -50,7 +117,7 @@ namespace detail {
         static constexpr bool value = std::is_same<decltype(test<T>(0)),yes>::value;
     };
     template<typename T> typename std::enable_if<has_method__post<T>::value, void>::type call_if_declared__post(T* self) {self->post();}
-    void call_if_declared__post(...) {}
+    inline void call_if_declared__post(...) {}
 
     template<typename T> struct has_method__notify {
     private:
@@ -62,75 +129,376 @@ namespace detail {
         static constexpr bool value = std::is_same<decltype(test<T>(0)),yes>::value;
     };
     template<typename T> typename std::enable_if<has_method__notify<T>::value, void>::type call_if_declared__notify(T* self, registry_type& r, EntityNotification n, const std::vector<entity>& e) {self->notify(r, n, e);}
-    void call_if_declared__notify(...) {}
+    inline void call_if_declared__notify(...) {}
+
+    template<typename T, typename... Components> struct has_method__update {
+    private:
+        typedef std::true_type yes;
+        typedef std::false_type no;
+        template<typename U> static auto test(int) -> decltype(std::declval<U>().update(std::declval<entity>(), std::declval<Components&>()...), yes());
+        template<typename> static no test(...);
+    public:
+        static constexpr bool value = std::is_same<decltype(test<T>(0)),yes>::value;
+    };
+
+    template<typename T, typename... Components> struct has_method__update_batch {
+    private:
+        typedef std::true_type yes;
+        typedef std::false_type no;
+        template<typename U> static auto test(int) -> decltype(std::declval<U>().update_batch(std::declval<span<const entity>>(), std::declval<span<Components>>()...), yes());
+        template<typename> static no test(...);
+    public:
+        static constexpr bool value = std::is_same<decltype(test<T>(0)),yes>::value;
+    };
+
+    // Component parameters taken by const reference (or by value) are read, everything else is written
+    template <typename Arg> void add_access (access_set& access) {
+        using Component = std::remove_cv_t<std::remove_reference_t<Arg>>;
+        component_info info{std::type_index(typeid(Component)), typeid(Component).name()};
+        if (std::is_const_v<std::remove_reference_t<Arg>> || !std::is_reference_v<Arg>) {
+            access.reads.push_back(info);
+        } else {
+            access.writes.push_back(info);
+        }
+    }
+
+    template <typename T, typename = void> struct declared_reads {
+        using type = type_list<>;
+    };
+    template <typename T> struct declared_reads<T, std::void_t<typename T::reads>> {
+        using type = typename T::reads;
+    };
+    template <typename T, typename = void> struct declared_writes {
+        using type = type_list<>;
+    };
+    template <typename T> struct declared_writes<T, std::void_t<typename T::writes>> {
+        using type = typename T::writes;
+    };
+    template <typename T> constexpr bool declares_access = ! std::is_same_v<typename declared_reads<T>::type, type_list<>> ||
+                                                           ! std::is_same_v<typename declared_writes<T>::type, type_list<>>;
+
+    template <typename... Types> void add_declared (std::vector<component_info>& components, type_list<Types...>*) {
+        (components.push_back({std::type_index(typeid(Types)), typeid(Types).name()}), ...);
+    }
+
+    template <typename Method> struct update_signature;
+    template <typename C, typename R, typename... Args> struct update_signature<R (C::*)(entity, Args...)> {
+        static void describe (access_set& access) {
+            (add_access<Args>(access), ...);
+        }
+    };
+    template <typename C, typename R, typename... Args> struct update_signature<R (C::*)(entity, Args...) const> : update_signature<R (C::*)(entity, Args...)> {};
+
+    // Same rules for update_batch(), where components arrive as span<const T> or span<T>
+    template <typename Method> struct update_batch_signature;
+    template <typename C, typename R, typename... Args> struct update_batch_signature<R (C::*)(span<const entity>, span<Args>...)> {
+        static void describe (access_set& access) {
+            (add_access<Args&>(access), ...);
+        }
+    };
+    template <typename C, typename R, typename... Args> struct update_batch_signature<R (C::*)(span<const entity>, span<Args>...) const> : update_batch_signature<R (C::*)(span<const entity>, span<Args>...)> {};
+
+    // The storage a system declared, batched systems must own all of their components and default to doing so
+    template <typename T, typename Default, typename = void> struct declared_storage {
+        using type = Default;
+    };
+    template <typename T, typename Default> struct declared_storage<T, Default, std::void_t<typename T::storage>> {
+        using type = typename T::storage;
+    };
+    template <typename T, typename... Components> using storage_for = typename declared_storage<T,
+        std::conditional_t<has_method__update_batch<T, Components...>::value, group_storage<Components...>, view_storage>>::type;
+
+    template <typename Storage, typename... Components> struct group_for {
+        static constexpr bool is_group = false;
+    };
+    template <typename... Owned, typename... Components> struct group_for<group_storage<Owned...>, Components...> {
+        static constexpr bool is_group = true;
+        template <typename Component> static constexpr bool owns = (std::is_same_v<Component, Owned> || ...);
+        static constexpr bool owns_all = (owns<Components> && ...);
+        template <typename Component> static constexpr bool is_component = (std::is_same_v<Component, Components> || ...);
+        static_assert((is_component<Owned> && ...), "Owned components must be components of the system");
+
+        // Components the group observes without owning them
+        using observed = decltype(std::tuple_cat(std::declval<std::conditional_t<owns<Components>, std::tuple<>, std::tuple<Components>>>()...));
+
+        static auto get (registry_type& registry) {
+            return get(registry, static_cast<observed*>(nullptr));
+        }
+        template <typename... Observed> static auto get (registry_type& registry, std::tuple<Observed...>*) {
+            return registry.template group<Owned...>(entt::get<Observed...>);
+        }
+
+        // Owned components are indexed directly, the rest have to be looked up by entity
+        template <typename Component, typename Group> static Component* packed (Group& group) {
+            if constexpr (owns<Component>) {
+                return group.template raw<Component>();
+            } else {
+                return nullptr;
+            }
+        }
+        template <typename Component, typename Group> static Component& fetch (Group& group, Component* packed, std::size_t index, entity e) {
+            if constexpr (owns<Component>) {
+                return packed[index];
+            } else {
+                return group.template get<Component>(e);
+            }
+        }
+    };
+    template <typename T, typename... Components> using storage_traits = group_for<storage_for<T, Components...>, Components...>;
 }
 
+/**
+ * Systems implement either
+ *     void update (ecs::entity, Components&...)
+ * which is called once per entity, or
+ *     void update_batch (ecs::span<const ecs::entity>, ecs::span<Components>...)
+ * which receives contiguous runs of packed component storage, suitable for SIMD kernels. Batched systems own their
+ * components through an EnTT group, so no two batched systems may share a component. See view_storage and
+ * group_storage for how other systems can choose to iterate a group.
+ * Use const components (const T& or span<const T>) for anything the system only reads, so the scheduler can run it
+ * alongside other readers.
+ * Systems that define neither only run pre(), notify() and post(), and are assumed to write all of their components.
+ */
 template <class This, typename... Components>
 class base_system : public system {
 public:
-    base_system()
-        : parallel(false) {
+    // Parallel systems have update() called concurrently from the job scheduler's workers, so update() must only touch the entity it was given
+    explicit base_system(bool parallel = false)
+        : parallel(parallel)
+        , tracked_registry(nullptr)
+        , run_allocations(0)
+        , completed_runs(0)
+        , last_processed(0) {
 
     }
-    virtual ~base_system() noexcept = default;
+    virtual ~base_system() noexcept {
+        untrack();
+    }
 
     void run (registry_type& registry) {
-        std::vector<entity> added;
-        std::vector<entity> removed;
-        detail::call_if_declared__pre(static_cast<This*>(this));
-        if (parallel) {
-            // auto view = registry.view<Components...>(entt::persistent_t{});
-            // tbb::concurrent_vector<entity> updatedEntities;
-            // tbb::parallel_for(tbb::blocked_range<std::size_t>(0, view.size()), [this,view,&updatedEntities](const tbb::blocked_range<size_t>& range){
-            //     auto iter = view.begin() + range.begin();
-            //     for (auto i = range.begin(); i != range.end(); ++i) {
-            //         auto entity = *iter++;
-            //         addLiveEntity(updatedEntities, entity);
-            //         static_cast<This*>(this)->update(entity, (view.template get<Components>(entity))...);
-            //     }
-            // });
-            // findAddedAndRemovedEntities(std::move(updatedEntities), added, removed);
+        track(registry);
+        {
+            allocations::Scope scope(run_allocations);
+            detail::call_if_declared__pre(static_cast<This*>(this), registry);
+        }
+        // Resolved here rather than at class scope, where This is still incomplete
+        using storage = detail::storage_traits<This, Components...>;
+        std::size_t processed = 0;
+        if constexpr (! detail::has_method__update<This, Components...>::value && ! detail::has_method__update_batch<This, Components...>::value) {
+            // Nothing to iterate, the system only reacts to pre(), notify() and post()
+        } else if constexpr (storage::is_group) {
+            // Group entities are already packed, so they can be split into chunks without gathering them first
+            auto group = storage::get(registry);
+            const entity* entities = group.data();
+            auto components = std::make_tuple(storage::template packed<Components>(group)...);
+            auto chunk = [this,entities,&group,&components](std::size_t begin, std::size_t end){
+                allocations::Scope scope(run_allocations);
+                if constexpr (detail::has_method__update_batch<This, Components...>::value) {
+                    static_assert(storage::owns_all, "update_batch() requires the system to own all of its components");
+                    const std::size_t count = end - begin;
+                    static_cast<This*>(this)->update_batch(span<const entity>(entities + begin, count),
+                                                           span<Components>(std::get<Components*>(components) + begin, count)...);
+                } else {
+                    for (auto index = begin; index != end; ++index) {
+                        auto entity = entities[index];
+                        static_cast<This*>(this)->update(entity, storage::template fetch<Components>(group, std::get<Components*>(components), index, entity)...);
+                    }
+                }
+            };
+            processed = group.size();
+            if (parallel && !services::locator::scheduler::empty()) {
+                services::locator::scheduler::ref().parallelFor(processed, parallel_chunk_size, chunk);
+            } else {
+                chunk(0, processed);
+            }
+        } else if (parallel && !services::locator::scheduler::empty()) {
+            // Gather matching entities up front, so that the view can be split into chunks of known size
+            auto view = registry.view<Components...>();
+            {
+                allocations::Scope scope(run_allocations);
+                chunk_entities.clear(); // Keeps its capacity, so this only allocates when the view grows
+                for (auto entity : view) {
+                    chunk_entities.push_back(entity);
+                }
+            }
+            processed = chunk_entities.size();
+            services::locator::scheduler::ref().parallelFor(processed, parallel_chunk_size, [this,&view](std::size_t begin, std::size_t end){
+                allocations::Scope scope(run_allocations);
+                for (auto index = begin; index != end; ++index) {
+                    auto entity = chunk_entities[index];
+                    static_cast<This*>(this)->update(entity, view.template get<Components>(entity)...);
+                }
+            });
         } else {
-            std::vector<entity> updatedEntities;
-            registry.view<Components...>().each([this,&updatedEntities](ecs::entity entity, auto&&... args){
-                addLiveEntity(updatedEntities, entity);
+            allocations::Scope scope(run_allocations);
+            auto view = registry.view<Components...>();
+            processed = view.size();
+            view.each([this](ecs::entity entity, auto&&... args){
                 static_cast<This*>(this)->update(entity, args...);
             });
-            findAddedAndRemovedEntities(std::move(updatedEntities), added, removed);
         }
-        // Compiled away if This::notify(r,n,e) is not defined
-        if constexpr (detail::has_method__notify<This>::value) {
-            if (removed.size() > 0) {
-                detail::call_if_declared__notify(static_cast<This*>(this), registry, EntityNotification::REMOVED, removed);
-            }
-            if (added.size() > 0) {
-                detail::call_if_declared__notify(static_cast<This*>(this), registry, EntityNotification::ADDED, added);
+        bool changed = false;
+        {
+            allocations::Scope scope(run_allocations);
+            // Compiled away if This::notify(r,n,e) is not defined
+            if constexpr (detail::has_method__notify<This>::value) {
+                // notify() may itself add or remove components, so hand it a snapshot of the pending changes
+                // Entities arrive in signal order, notify() gets them sorted
+                if (removed.size() > 0) {
+                    changed = true;
+                    std::swap(removed, notifying);
+                    std::sort(notifying.begin(), notifying.end());
+                    detail::call_if_declared__notify(static_cast<This*>(this), registry, EntityNotification::REMOVED, notifying);
+                    notifying.clear();
+                }
+                if (added.size() > 0) {
+                    changed = true;
+                    for (auto entity : added) {
+                        added_slots[entity_index(entity)] = NotAdded;
+                    }
+                    std::swap(added, notifying);
+                    std::sort(notifying.begin(), notifying.end());
+                    detail::call_if_declared__notify(static_cast<This*>(this), registry, EntityNotification::ADDED, notifying);
+                    notifying.clear();
+                }
             }
+            detail::call_if_declared__post(static_cast<This*>(this));
+        }
+        checkAllocations(processed, changed);
+    }
+
+    void prepare (registry_type& registry) {
+        using storage = detail::storage_traits<This, Components...>;
+        if constexpr (storage::is_group) {
+            storage::get(registry);
+        } else {
+            registry.view<Components...>();
+        }
+        track(registry);
+    }
+
+    access_set access () const {
+        access_set access{{}, {}, false};
+        if constexpr (detail::has_method__update_batch<This, Components...>::value) {
+            detail::update_batch_signature<decltype(&This::update_batch)>::describe(access);
+        } else if constexpr (detail::has_method__update<This, Components...>::value) {
+            detail::update_signature<decltype(&This::update)>::describe(access);
+        } else {
+            (detail::add_access<Components&>(access), ...);
         }
-        detail::call_if_declared__post(static_cast<This*>(this));
+        detail::add_declared(access.reads, static_cast<typename detail::declared_reads<This>::type*>(nullptr));
+        detail::add_declared(access.writes, static_cast<typename detail::declared_writes<This>::type*>(nullptr));
+        // pre(registry) could touch anything in the registry, so unless the system says what it touches, run it alone
+        if constexpr (detail::has_method__pre_registry<This>::value && ! detail::declares_access<This>) {
+            access.exclusive = true;
+        }
+        return access;
+    }
+
+    std::string name () const {
+        return helpers::demangle(typeid(This).name());
     }
 
 private:
+    // Number of entities each parallel job updates
+    static constexpr std::size_t parallel_chunk_size = 512;
+
     bool parallel;
-    std::vector<entity> liveEntities;
 
-    template <typename T>
-    inline void addLiveEntity (T& current, entity e) {
+    // Entities that entered or left the system's view since the last notify(), maintained by registry signals
+    registry_type* tracked_registry;
+    std::vector<entity> added;
+    std::vector<entity> removed;
+    std::vector<entity> notifying;
+    // Position of each pending entity in added, indexed by entity index, so cancelling an addition is constant time
+    static constexpr std::uint32_t NotAdded = std::uint32_t(-1);
+    std::vector<std::uint32_t> added_slots;
+
+    // Scratch space for splitting a view into parallel chunks, reused between runs
+    std::vector<entity> chunk_entities;
+
+    // Heap allocations made by the current run, only counted in debug builds
+    static constexpr std::size_t steady_state_warmup_runs = 2;
+    std::atomic<std::size_t> run_allocations;
+    std::size_t completed_runs;
+    std::size_t last_processed;
+
+    // A run is in steady state once the system has warmed up and the set of entities it processes has not changed.
+    // Scratch buffers have reached their final size by then, so any allocation is a per-frame cost that should be removed.
+    void checkAllocations (std::size_t processed, bool changed) {
+#ifdef DEBUG_BUILD
+        const std::size_t allocated = run_allocations.exchange(0, std::memory_order_relaxed);
+        if (allocated > 0 && !changed && processed == last_processed && completed_runs >= steady_state_warmup_runs) {
+            error("{} made {} heap allocations in steady state", name(), allocated);
+            steady_state_allocations().fetch_add(allocated, std::memory_order_relaxed);
+        }
+        last_processed = processed;
+        ++completed_runs;
+#endif
+    }
+
+    void track (registry_type& registry) {
         // Compiled away if This::notify(r,n,e) is not defined
         if constexpr (detail::has_method__notify<This>::value) {
-            current.push_back(e);
+            if (tracked_registry == &registry) {
+                return;
+            }
+            untrack();
+            tracked_registry = &registry;
+            (registry.template on_construct<Components>().template connect<&base_system::onConstruct>(*this), ...);
+            (registry.template on_destroy<Components>().template connect<&base_system::onDestroy>(*this), ...);
+            // Entities that existed before the system was attached count as added
+            for (auto entity : registry.view<Components...>()) {
+                markAdded(entity);
+            }
         }
     }
 
-    template <typename T>
-    inline void findAddedAndRemovedEntities (T&& current, std::vector<entity>& added, std::vector<entity>& removed) {
-        // Compiled away if This::notify(r,n,e) is not defined
+    void untrack () {
         if constexpr (detail::has_method__notify<This>::value) {
-            std::sort(current.begin(), current.end());
-            std::set_difference(current.begin(), current.end(), liveEntities.begin(), liveEntities.end(), std::back_inserter(added));
-            std::set_difference(liveEntities.begin(), liveEntities.end(), current.begin(), current.end(), std::back_inserter(removed));
-            liveEntities.clear();
-            liveEntities.insert(liveEntities.end(), std::make_move_iterator(current.begin()), std::make_move_iterator(current.end()));
+            if (tracked_registry) {
+                (tracked_registry->template on_construct<Components>().template disconnect<&base_system::onConstruct>(*this), ...);
+                (tracked_registry->template on_destroy<Components>().template disconnect<&base_system::onDestroy>(*this), ...);
+                tracked_registry = nullptr;
+            }
+        }
+    }
+
+    // Called after one of Components was assigned, the entity joins the view once it has all of them
+    void onConstruct (registry_type& registry, entity e) {
+        if (registry.template has<Components...>(e)) {
+            markAdded(e);
+        }
+    }
+
+    // Called before one of Components is removed, the entity leaves the view if it currently has all of them
+    void onDestroy (registry_type& registry, entity e) {
+        if (registry.template has<Components...>(e)) {
+            const auto index = entity_index(e);
+            const auto slot = index < added_slots.size() ? added_slots[index] : NotAdded;
+            if (slot < added.size() && added[slot] == e) {
+                // Added and removed before notify() ever saw it, move the last pending entity into its place
+                added_slots[index] = NotAdded;
+                if (slot + 1 != added.size()) {
+                    added[slot] = added.back();
+                    added_slots[entity_index(added[slot])] = slot;
+                }
+                added.pop_back();
+            } else {
+                removed.push_back(e);
+            }
+        }
+    }
+
+    void markAdded (entity e) {
+        const auto index = entity_index(e);
+        if (index >= added_slots.size()) {
+            added_slots.resize(index + 1, NotAdded);
+        }
+        auto& slot = added_slots[index];
+        if (slot >= added.size() || added[slot] != e) {
+            slot = std::uint32_t(added.size());
+            added.push_back(e);
         }
     }
 };
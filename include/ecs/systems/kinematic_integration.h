@@ -0,0 +1,63 @@
+#ifndef ECS_SYSTEMS_KINEMATIC_INTEGRATION_H
+#define ECS_SYSTEMS_KINEMATIC_INTEGRATION_H
+
+#include <cstddef>
+#include <limits>
+
+#include <ecs/system.h>
+
+#include <ecs/components/kinematic_body.h>
+#include <ecs/components/position.h>
+#include <ecs/systems/kinematic_integration_kernels.h>
+
+#include <util/clock.h>
+
+namespace ecs::systems {
+
+/**
+ * Moves kinematic bodies without going through Bullet. Bodies only interact with the ground plane and the level bounds,
+ * so each one costs a handful of SIMD instructions per tick and hundreds of thousands of them are affordable.
+ */
+class kinematic_integration : public ecs::base_system<kinematic_integration, ecs::components::kinematic_body, ecs::components::position> {
+public:
+    kinematic_integration (DeltaTime_t tick_length)
+        : base_system(true)
+        , step{tick_length, -10.0f, 0.0f,
+               -std::numeric_limits<float>::max(), std::numeric_limits<float>::max(),
+               -std::numeric_limits<float>::max(), std::numeric_limits<float>::max()}
+        , integrate(kernels::select_integrate())
+    {}
+    ~kinematic_integration () noexcept = default;
+
+    // Ground height is taken from min.y, max.y is ignored
+    void setBounds (const glm::vec3& min, const glm::vec3& max) {
+        step.ground = min.y;
+        step.min_x = min.x;
+        step.max_x = max.x;
+        step.min_z = min.z;
+        step.max_z = max.z;
+    }
+
+    void update_batch (ecs::span<const ecs::entity>, ecs::span<ecs::components::kinematic_body> bodies, ecs::span<ecs::components::position> positions) {
+        using ecs::components::kinematic_body;
+        using ecs::components::position;
+        // The kernels see components as strided floats, see integrate_fn for the layout they expect
+        static_assert(offsetof(kinematic_body, velocity) == 0 && offsetof(kinematic_body, restitution) == 3 * sizeof(float), "kinematic_body must start with velocity then restitution");
+        static_assert(offsetof(position, position) == 0 && sizeof(position) >= 4 * sizeof(float), "position must start with position and span at least four floats");
+        if (bodies.empty()) {
+            return;
+        }
+        integrate(step,
+                  &bodies[0].velocity.x, sizeof(kinematic_body) / sizeof(float),
+                  &positions[0].position.x, sizeof(position) / sizeof(float),
+                  bodies.size());
+    }
+
+private:
+    kernels::kinematic_step step;
+    kernels::integrate_fn integrate;
+};
+
+}
+
+#endif // ECS_SYSTEMS_KINEMATIC_INTEGRATION_H
@@ -0,0 +1,36 @@
+#ifndef KINEMATIC_INTEGRATION_KERNELS_H
+#define KINEMATIC_INTEGRATION_KERNELS_H
+
+#include <cstddef>
+
+// Included by the per-ISA kernels, so free of glm and engine headers, see AVX2_SOURCES in CMakeLists.txt
+namespace ecs::systems::kernels {
+
+struct kinematic_step {
+    float delta;
+    float gravity;
+    // Bodies are kept above the ground plane and inside the bounds on the x and z axes
+    float ground;
+    float min_x, max_x;
+    float min_z, max_z;
+};
+
+/**
+ * Apply gravity and velocity to count bodies for one step, bouncing them off the ground and bounds.
+ * Bodies and positions are strided arrays of floats, so they can point straight into component storage: each body starts
+ * with its velocity x, y, z and restitution, each position starts with its x, y, z, and strides are counted in floats.
+ * Strides must be at least 4, the SIMD kernels load and store the first four floats of each element at once and write
+ * back the fourth float of a position unchanged.
+ */
+using integrate_fn = void (*)(const kinematic_step& step, float* bodies, std::size_t body_stride, float* positions, std::size_t position_stride, std::size_t count);
+
+void integrate_scalar (const kinematic_step& step, float* bodies, std::size_t body_stride, float* positions, std::size_t position_stride, std::size_t count);
+void integrate_sse41 (const kinematic_step& step, float* bodies, std::size_t body_stride, float* positions, std::size_t position_stride, std::size_t count);
+void integrate_avx2 (const kinematic_step& step, float* bodies, std::size_t body_stride, float* positions, std::size_t position_stride, std::size_t count);
+
+// Fastest kernel supported by the CPU we are running on
+integrate_fn select_integrate ();
+
+}
+
+#endif // KINEMATIC_INTEGRATION_KERNELS_H
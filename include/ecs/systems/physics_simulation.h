@@ -10,40 +10,58 @@
 
 namespace ecs::systems {
 
+/**
+ * Keeps Bullet bodies in step with entities and applies the positions of bodies that moved during the last step.
+ */
 class physics_simulation : public ecs::base_system<physics_simulation, ecs::components::physics_body, ecs::components::position> {
 public:
+    // pre() writes positions through the registry and both pre() and notify() drive the physics service
+    using writes = ecs::type_list<ecs::components::position, services::Physics>;
+
     physics_simulation () : physics(services::locator::physics::get().lock()) {
     }
 
     ~physics_simulation() {
     }
 
-    void update (const ecs::entity e, const ecs::components::physics_body& physics_body, ecs::components::position& position) {
-        physics->getBodyPosition(e, position.position);
+    // Only bodies that moved during the last step are written back, bodies at rest cost nothing
+    void pre (ecs::registry_type& registry) {
+        auto moved = physics->movedBodies();
+        for (std::size_t index = 0; index < moved.entities.size(); ++index) {
+            auto entity = moved.entities[index];
+            // The entity may have been destroyed since the step, its body is removed in notify()
+            if (registry.valid(entity) && registry.has<ecs::components::position>(entity)) {
+                registry.get<ecs::components::position>(entity).position = moved.positions[index];
+            }
+        }
     }
 
     void notify (ecs::registry_type& registry, ecs::EntityNotification notification, const std::vector<ecs::entity>& entities) {
         switch (notification) {
             case ecs::EntityNotification::ADDED:
+                info("{} entities added to physics system", entities.size());
+                new_bodies.clear();
+                new_shapes.clear();
                 for (auto entity : entities) {
-                    info("Entity {} added to physics system", to_integer(entity));
-                    auto position = registry.get<ecs::components::position>(entity);
-                    physics->addBody(entity,
-                            services::Physics::Body{position.position + glm::vec3(0, 1.0f, 0), 1.0f, 0.5f, 1.0f},
-                            services::Physics::Shape{glm::vec3(0.5f, 1.0f, 0.5f)});
+                    const auto& position = registry.get<ecs::components::position>(entity);
+                    const auto& physics_body = registry.get<ecs::components::physics_body>(entity);
+                    new_bodies.push_back({position.position + glm::vec3(0, 1.0f, 0), physics_body.mass, physics_body.friction, physics_body.restitution});
+                    new_shapes.push_back({physics_body.half_extents});
                 }
+                physics->addBodies(entities, new_bodies, new_shapes);
                 break;
             case ecs::EntityNotification::REMOVED:
-                 for (auto entity : entities) {
-                    info("Entity {} removed from physics system", to_integer(entity));
-                    physics->removeBody(entity);
-                }
+                info("{} entities removed from physics system", entities.size());
+                physics->removeBodies(entities);
                 break;
         };
     }
 
 private:
     std::shared_ptr<services::Physics> physics;
+    // Scratch space for batching new bodies, reused between notifications
+    std::vector<services::Physics::Body> new_bodies;
+    std::vector<services::Physics::Shape> new_shapes;
 };
 
 }
@@ -0,0 +1,23 @@
+#ifndef ECS_SYSTEMS_POSITION_SNAPSHOT_H
+#define ECS_SYSTEMS_POSITION_SNAPSHOT_H
+
+#include <ecs/system.h>
+
+#include <ecs/components/position.h>
+
+namespace ecs::systems {
+
+// Runs first in every simulation tick, so that rendering can interpolate between the last two ticks
+class position_snapshot : public ecs::base_system<position_snapshot, ecs::components::position> {
+public:
+    position_snapshot () : base_system(true) {
+    }
+
+    void update (ecs::entity, ecs::components::position& position) {
+        position.previous = position.position;
+    }
+};
+
+}
+
+#endif // ECS_SYSTEMS_POSITION_SNAPSHOT_H
@@ -5,34 +5,44 @@
 
 #include <ecs/components/bitmap_animation.h>
 #include <ecs/components/sprite.h>
+#include <ecs/systems/sprite_animation_kernels.h>
+
+#include <util/clock.h>
 
 namespace ecs::systems {
 
 class sprite_animation : public ecs::base_system<sprite_animation, ecs::components::bitmap_animation, ecs::components::sprite> {
 public:
-    sprite_animation () {}
+    sprite_animation ()
+        : base_system(true)
+        , current_time(0)
+        , previous_time(0)
+        , delta(0)
+        , animate(kernels::select_animate())
+    {}
     ~sprite_animation () noexcept = default;
 
     void setTime (ElapsedTime_t elapsed_time) {
         current_time = elapsed_time;
     }
 
-    void update (ecs::entity, ecs::components::bitmap_animation& animation, ecs::components::sprite& sprite) {
-        auto elapsed = current_time - animation.start_time;
-        float delta = float(elapsed) * 0.000001f;
-        if (delta > animation.speed) {
-            if (++animation.current_frame >= animation.max_frames) {
-                animation.current_frame = 0;
-            }
-            animation.start_time = current_time;
-        }
-        float image = sprite.image;
-        sprite.image = animation.base_image + animation.current_frame;
+    void pre () {
+        // Convert to seconds once per frame, rather than once per entity
+        delta = float(current_time - previous_time) * 0.000001f;
+        previous_time = current_time;
+    }
+
+    void update_batch (ecs::span<const ecs::entity>, ecs::span<ecs::components::bitmap_animation> animations, ecs::span<ecs::components::sprite> sprites) {
+        animate(delta, animations.data(), sprites.data(), animations.size());
     }
+
 private:
     ElapsedTime_t current_time;
+    ElapsedTime_t previous_time;
+    float delta;
+    kernels::animate_fn animate;
 };
 
 }
 
-#endif // SPRITE_ANIMATION_H
\ No newline at end of file
+#endif // SPRITE_ANIMATION_H
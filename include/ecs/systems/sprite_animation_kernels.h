@@ -0,0 +1,25 @@
+#ifndef SPRITE_ANIMATION_KERNELS_H
+#define SPRITE_ANIMATION_KERNELS_H
+
+#include <cstddef>
+
+#include <ecs/components/bitmap_animation.h>
+#include <ecs/components/sprite.h>
+
+// Included by the per-ISA kernels, so it includes nothing but the plain component structs it works on, see AVX2_SOURCES
+// in CMakeLists.txt
+namespace ecs::systems::kernels {
+
+// Advance count animations by delta seconds and write the resulting image into the matching sprites
+using animate_fn = void (*)(float delta, ecs::components::bitmap_animation* animations, ecs::components::sprite* sprites, std::size_t count);
+
+void animate_scalar (float delta, ecs::components::bitmap_animation* animations, ecs::components::sprite* sprites, std::size_t count);
+void animate_sse41 (float delta, ecs::components::bitmap_animation* animations, ecs::components::sprite* sprites, std::size_t count);
+void animate_avx2 (float delta, ecs::components::bitmap_animation* animations, ecs::components::sprite* sprites, std::size_t count);
+
+// Fastest kernel supported by the CPU we are running on
+animate_fn select_animate ();
+
+}
+
+#endif // SPRITE_ANIMATION_KERNELS_H
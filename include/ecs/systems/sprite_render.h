@@ -14,6 +14,18 @@ namespace ecs::systems {
 
 class sprite_render : public ecs::base_system<sprite_render, ecs::components::sprite, ecs::components::position> {
 public:
+    // sprite is owned by sprite_animation's group and position by kinematic_integration's, so this group can't own either
+    using storage = ecs::group_storage<>;
+    // pre() requests a buffer from the resources service and post() submits it to the renderer
+    using writes = ecs::type_list<services::Resources, services::Renderer>;
+
+    sprite_render () : interpolation(1.0f) {
+    }
+
+    // How far rendering is between the previous and the latest simulation tick, from 0 to 1
+    void setInterpolation (float alpha) {
+        interpolation = alpha;
+    }
 
     void pre () {
         sprite_data_handle = services::locator::resources::ref().request("sprites"_hs);
@@ -22,7 +34,7 @@ public:
 
     void update (ecs::entity, const ecs::components::sprite& sprite, const ecs::components::position& position) {
         // gather commands for renderer
-        sprites.emplace_back(position.position, sprite.image);
+        sprites.emplace_back(glm::mix(position.previous, position.position, interpolation), sprite.image);
     }
 
     void post () {
@@ -36,6 +48,7 @@ public:
 private:
     resources::Handle sprite_data_handle;
     resources::Buffer<graphics::Sprite> sprites;
+    float interpolation;
 };
 
 }
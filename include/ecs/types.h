@@ -1,6 +1,9 @@
 #ifndef ECS_TYPES_H
 #define ECS_TYPES_H
 
+#include <cstddef>
+#include <type_traits>
+
 #include <entt/entity/registry.hpp>
 
 namespace ecs {
@@ -8,6 +11,31 @@ namespace ecs {
 using registry_type = entt::registry;
 using entity = registry_type::entity_type;
 
+// Index part of an entity identifier with the version stripped, suitable for indexing arrays sized by entity count
+inline std::size_t entity_index (entity e) {
+    return std::size_t(entt::to_integer(e) & entt::entt_traits<std::underlying_type_t<entity>>::entity_mask);
+}
+
+// Non-owning view of a contiguous run of entities or components
+template <typename T>
+class span {
+public:
+    span (T* items, std::size_t count) : items(items), count(count) {}
+    template <typename U, typename = std::enable_if_t<std::is_convertible<U(*)[], T(*)[]>::value>>
+    span (const span<U>& other) : items(other.data()), count(other.size()) {}
+
+    inline T* data () const { return items; }
+    inline std::size_t size () const { return count; }
+    inline bool empty () const { return count == 0; }
+    inline T& operator[] (std::size_t index) const { return items[index]; }
+    inline T* begin () const { return items; }
+    inline T* end () const { return items + count; }
+
+private:
+    T* items;
+    std::size_t count;
+};
+
 }
 
 #endif // ECS_TYPES_H
\ No newline at end of file
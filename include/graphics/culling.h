@@ -0,0 +1,27 @@
+#ifndef GRAPHICS_CULLING_H
+#define GRAPHICS_CULLING_H
+
+#include <cstddef>
+
+// Included by the per-ISA kernels, so free of glm and engine headers, see AVX2_SOURCES in CMakeLists.txt
+namespace graphics::culling {
+
+// Sprites are culled as records of four floats, laid out like graphics::Sprite: position x, y, z then image
+constexpr std::size_t SpriteFloats = 4;
+
+// Copy every sprite whose bounding sphere (of the given radius, around its position) touches the frustum described by
+// the six planes (a, b, c, d each, normals pointing inwards, normalized) to out, keeping their order, and return how many
+// were copied. Every sprite is written to out and only kept if visible, so there is no branching per sprite. out needs
+// room for count sprites, and may be the same as sprites to compact in place.
+using cull_fn = std::size_t (*)(const float* planes, float radius, const float* sprites, std::size_t count, float* out);
+
+std::size_t cull_scalar (const float* planes, float radius, const float* sprites, std::size_t count, float* out);
+std::size_t cull_sse41 (const float* planes, float radius, const float* sprites, std::size_t count, float* out);
+std::size_t cull_avx2 (const float* planes, float radius, const float* sprites, std::size_t count, float* out);
+
+// Fastest kernel supported by the CPU we are running on
+cull_fn select_cull ();
+
+}
+
+#endif // GRAPHICS_CULLING_H
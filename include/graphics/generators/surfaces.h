@@ -3,6 +3,7 @@
 
 #include "graphics/mesh.h"
 #include "graphics/imagesets.h"
+#include "util/surfaces.h"
 
 namespace graphics {
 
@@ -40,33 +41,16 @@ public:
 
     }
 
-    void newSurface (const entt::hashed_string& id, float num_rows) {
-        imageset_idx = imagesets.get(id);
-        row = num_rows;
-    }
-
-    template <typename T, typename VertexTransformFn>
-    void addRow (const std::vector<T> cells, VertexTransformFn vertexTransform) {
-        auto& surface = surface_map[imageset_idx];
-        float col = 0;
-        for (const auto& layer : cells) {
-            surface.vertices.push_back(vertexTransform(glm::vec4{col,   row  , 0, 1}));
-            surface.vertices.push_back(vertexTransform(glm::vec4{col,   row-1, 0, 1}));
-            surface.vertices.push_back(vertexTransform(glm::vec4{col+1, row-1, 0, 1}));
-            surface.vertices.push_back(vertexTransform(glm::vec4{col+1, row-1, 0, 1}));
-            surface.vertices.push_back(vertexTransform(glm::vec4{col+1, row  , 0, 1}));
-            surface.vertices.push_back(vertexTransform(glm::vec4{col,   row  , 0, 1}));
-
-            surface.textureCoordinates.push_back(glm::vec3(0, 0, layer));
-            surface.textureCoordinates.push_back(glm::vec3(0, 1, layer));
-            surface.textureCoordinates.push_back(glm::vec3(1, 1, layer));
-            surface.textureCoordinates.push_back(glm::vec3(1, 1, layer));
-            surface.textureCoordinates.push_back(glm::vec3(1, 0, layer));
-            surface.textureCoordinates.push_back(glm::vec3(0, 0, layer));
-
-            ++col;
-        }
-        --row;
+    void addSurface (const surfaces::Surface& surface) {
+        auto& temp = surface_map[imagesets.get(entt::hashed_string{surface.imageset.data()})];
+        // Texture coordinates of the corners passed by forEachTile
+        static constexpr float CornerUVs[4][2] = {{0, 0}, {0, 1}, {1, 1}, {1, 0}};
+        surfaces::forEachTile(surface, [&temp](std::int64_t image, const std::array<glm::vec3, 4>& corners){
+            for (auto corner : surfaces::TileTriangles) {
+                temp.vertices.push_back(corners[corner]);
+                temp.textureCoordinates.push_back(glm::vec3(CornerUVs[corner][0], CornerUVs[corner][1], image));
+            }
+        });
     }
 
     std::vector<Surface> complete () {
@@ -85,9 +69,6 @@ public:
 private:
     const graphics::Imagesets& imagesets;
     std::map<int, TempSurface> surface_map;
-    // Per-surface temporary data
-    int imageset_idx;
-    float row;
 };
 
 }
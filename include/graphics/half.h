@@ -0,0 +1,38 @@
+#ifndef GRAPHICS_HALF_H
+#define GRAPHICS_HALF_H
+
+#include <cstdint>
+#include <cstring>
+
+namespace graphics {
+
+// Convert to a 16 bit float the way F16C does, without requiring it: rounding to nearest even and overflowing to
+// infinity. NaNs stay NaNs with their sign, but lose their payload. Inline, since packing sprites calls it four times
+// per sprite.
+inline std::uint16_t toHalf (float value) {
+    std::uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    const std::uint32_t sign = (bits >> 16) & 0x8000u;
+    bits &= 0x7fffffffu;
+    std::uint32_t half;
+    if (bits >= 0x47800000u) { // Too large for a half, or infinity or NaN
+        half = bits > 0x7f800000u ? 0x7e00u : 0x7c00u;
+    } else if (bits < 0x38800000u) { // Subnormal half, let the FPU do the rounding by adding 0.5
+        constexpr std::uint32_t magic_bits = 0x3f000000u;
+        float magic, shifted;
+        std::memcpy(&magic, &magic_bits, sizeof(magic));
+        std::memcpy(&shifted, &bits, sizeof(shifted));
+        shifted += magic;
+        std::memcpy(&half, &shifted, sizeof(half));
+        half -= magic_bits;
+    } else {
+        const std::uint32_t odd = (bits >> 13) & 1u;
+        bits += 0xc8000fffu + odd; // Rebias the exponent from 127 to 15 and round
+        half = bits >> 13;
+    }
+    return std::uint16_t(half | sign);
+}
+
+}
+
+#endif // GRAPHICS_HALF_H
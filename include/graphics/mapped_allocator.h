@@ -0,0 +1,67 @@
+#ifndef GRAPHICS_MAPPED_ALLOCATOR_H
+#define GRAPHICS_MAPPED_ALLOCATOR_H
+
+#ifndef GL3_PROTOTYPES
+#define GL3_PROTOTYPES 1
+#endif
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <vector>
+
+#include <services/core/resources.h>
+#include "graphics/section_ring.h"
+
+namespace graphics {
+
+/**
+ * Resources allocator whose buffers live in persistently mapped GL buffer memory, so that whatever is gathered into
+ * them is already on its way to the GPU and can be drawn without being copied.
+ * The memory is split into the sections of a SectionRing. Every buffer handed out by request() gets the same region in
+ * each section, and advance() moves all of them to the next section once the GPU has finished reading it. The memory
+ * is also readable by the CPU, so it can be processed (culled) in place before being drawn. Without ARB_buffer_storage
+ * the buffers fall back to host memory and contains() is always false, so they are uploaded like any other buffer.
+ */
+class MappedBufferAllocator : public services::Resources::Allocator {
+public:
+    struct Region {
+        buffer_t texture; // Texture buffer over the whole section
+        std::size_t offset; // Byte offset of the buffer's data within the section
+    };
+
+    MappedBufferAllocator (GLenum texture_format);
+    ~MappedBufferAllocator ();
+
+    void allocate (std::size_t bytes);
+    void deallocate ();
+    void* request (std::size_t alignment, std::size_t size, std::size_t count);
+    void release (void* buffer);
+    // Regions hold instance data read as vec4s
+    std::size_t minAlignment () const;
+
+    // Whether data points into mapped GPU memory handed out by this allocator
+    bool contains (const void* data) const;
+    Region region (const void* data) const;
+
+    // Fence the current section, to be called after the draws reading it were issued, and point every buffer at the
+    // next section, waiting for the GPU to finish with it if needed
+    void advance ();
+
+private:
+    struct Placement {
+        resources::MemoryBuffer* buffer;
+        std::size_t offset;
+    };
+    SectionRing ring;
+    std::vector<Placement> placements;
+    std::vector<void*> headers;
+    char* base; // Start of the current section, or of host memory when not mapped
+    std::size_t section_size;
+    std::size_t top;
+    GLenum format;
+    bool mapped;
+};
+
+}
+
+#endif // GRAPHICS_MAPPED_ALLOCATOR_H
@@ -5,6 +5,7 @@
 
 #include <graphics/shader.h>
 #include <graphics/spritepool.h>
+#include <graphics/mapped_allocator.h>
 #include <graphics/imagesets.h>
 
 #include <graphics/generators/surfaces.h>
@@ -14,7 +15,8 @@ namespace graphics {
 
 class Renderer : public services::Renderer {
 public:
-    Renderer ();
+    // Sprites gathered into buffers from mapped_allocator are drawn straight from GPU memory, it may be null
+    Renderer (MappedBufferAllocator* mapped_allocator);
     ~Renderer();
 
     void init ();
@@ -30,6 +32,7 @@ public:
 
 private:
     std::vector<resources::Handle> sprite_data;
+    MappedBufferAllocator* mapped_allocator;
     std::vector<graphics::Surface> level;
 
     glm::ivec4 viewport;
@@ -0,0 +1,64 @@
+#ifndef GRAPHICS_SECTION_RING_H
+#define GRAPHICS_SECTION_RING_H
+
+#ifndef GL3_PROTOTYPES
+#define GL3_PROTOTYPES 1
+#endif
+#include <GL/glew.h>
+
+#include <array>
+#include <cstddef>
+
+#include "graphics/shader.h"
+
+namespace graphics {
+
+/**
+ * Ring of GL buffers, each with a texture buffer over it and a fence, for data the CPU writes while the GPU is still
+ * reading the sections written in previous frames. Sections are fenced once the draws reading them were issued and
+ * waited on before they are written to again.
+ */
+class SectionRing {
+public:
+    static constexpr std::size_t Sections = 3;
+
+    struct Section {
+        buffer_t buffer;
+        buffer_t texture;
+        GLsync fence;
+        void* memory; // Only set when persistently mapped
+    };
+
+    SectionRing ();
+    ~SectionRing ();
+
+    // Create every section with bytes of storage. With map_flags, the storage is immutable (ARB_buffer_storage), created
+    // with map_flags and storage_flags, and mapped persistently with map_flags. Without, it is mutable stream storage and
+    // left unmapped.
+    void create (GLenum texture_format, std::size_t bytes, GLbitfield map_flags = 0, GLbitfield storage_flags = 0);
+    void destroy ();
+
+    // Block until the GPU is done reading the current section
+    void wait ();
+    // Fence the current section, to be called after the draws reading it were issued, and move on to the next one
+    void fence ();
+
+    inline Section& current () {
+        return sections[index];
+    }
+    inline const Section& current () const {
+        return sections[index];
+    }
+    inline std::size_t size () const {
+        return section_size;
+    }
+
+private:
+    std::array<Section, Sections> sections;
+    std::size_t index;
+    std::size_t section_size;
+};
+
+}
+
+#endif // GRAPHICS_SECTION_RING_H
@@ -0,0 +1,25 @@
+#ifndef GRAPHICS_SPRITE_H
+#define GRAPHICS_SPRITE_H
+
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+namespace graphics {
+
+// Per-instance sprite data, as uploaded to the GPU
+struct Sprite {
+    glm::vec3 position;
+    float image;
+};
+
+// Half the size of Sprite, with every field as a 16 bit float. Positions lose precision away from the origin (steps of
+// 1/16 beyond 128 units) and image indices are only exact up to 2048.
+struct PackedSprite {
+    std::uint16_t position[3];
+    std::uint16_t image;
+};
+
+}
+
+#endif // GRAPHICS_SPRITE_H
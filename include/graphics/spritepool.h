@@ -1,17 +1,19 @@
 #ifndef SPRITEPOOL_H
 #define SPRITEPOOL_H
 
+#include <array>
+#include <vector>
+
 #include "mesh.h"
 #include "shader.h"
 #include "math/basic.h"
+#include "graphics/culling.h"
+#include "graphics/mapped_allocator.h"
+#include "graphics/sprite.h"
+#include "graphics/stream_buffer.h"
 
 namespace graphics {
 
-struct Sprite {
-    glm::vec3 position;
-    float image;
-};
-
 #define INSTANCED_SPRITES
 // #define VBO_SPRITES
 
@@ -22,28 +24,50 @@ public:
     SpritePool ();
     ~SpritePool ();
 
-    void init (const graphics::shader& spriteShader, int texture_unit);
+    // Packed pools upload PackedSprite instances, half the bandwidth at the cost of precision
+    void init (const graphics::shader& spriteShader, int texture_unit, bool packed);
     void update (Sprite* const sprite_data, std::size_t num_sprites);
 
-    void render (Sprite* const sprite_data, std::size_t num_sprites);
+    void unload ();
+
+    // Start collecting a frame's sprites, with room for up to max_sprites of them in the instance buffer
+    void begin (const math::frustum& frustum, std::size_t max_sprites);
+    // Culls the sprites against the frustum, appending the visible ones straight to the mapped instance buffer
+    void add (const Sprite* const sprite_data, std::size_t num_sprites);
+    // Draws every sprite added since begin()
+    void render ();
+    // Culls sprites that are already in mapped GPU memory in place, against the frustum given to begin(), and draws them
+    void render (const MappedBufferAllocator::Region& region, Sprite* const sprite_data, std::size_t num_sprites);
 
 private:
+    inline std::size_t instanceSize () const {
+        return packed_instances ? sizeof(PackedSprite) : sizeof(Sprite);
+    }
+
     std::vector<Sprite> sortedBuffer;
     std::vector<Sprite> unsortedBuffer;
     graphics::mesh mesh;
-    graphics::buffer_t tbo;
-    graphics::buffer_t tbo_tex;
+    graphics::StreamBuffer instances;
     graphics::uniform u_tbo_tex;
+    graphics::uniform u_first_instance;
     graphics::uniform u_texture;
 
     glm::vec2 prevCenterPoint;
     std::size_t visibleSprites;
 
-    std::vector<int> culling_results;
+    culling::cull_fn cull_spheres;
+    std::array<glm::vec4, 6> cull_planes;
+    float cull_radius;
 
-    std::size_t spriteCount;
+    // Instance memory of the current frame, and how many sprites fit in it
+    void* mapped_instances;
+    std::size_t mapped_capacity;
 
-    std::size_t cull_sprites (const math::frustum& frustum, std::vector<graphics::Sprite>& positions);
+    // When packing, sprites are culled into culled_sprites and then packed into the instance memory
+    bool packed_instances;
+    std::vector<Sprite> culled_sprites;
+
+    std::size_t spriteCount;
 
 };
 #elif VBO_SPRITES
@@ -0,0 +1,55 @@
+#ifndef GRAPHICS_STREAM_BUFFER_H
+#define GRAPHICS_STREAM_BUFFER_H
+
+#ifndef GL3_PROTOTYPES
+#define GL3_PROTOTYPES 1
+#endif
+#include <GL/glew.h>
+
+#include <cstddef>
+
+#include "graphics/section_ring.h"
+
+namespace graphics {
+
+/**
+ * Ring of texture buffers that the CPU fills while the GPU is still reading the ones from previous frames.
+ * Every section has its own buffer and texture, so a samplerBuffer can read a whole section without needing
+ * glTexBufferRange.
+ * With ARB_buffer_storage each section is mapped once, persistently and coherently. Otherwise (such as on plain 4.1)
+ * the section is mapped unsynchronized every frame, which is safe because its fence has already been waited on.
+ */
+class StreamBuffer {
+public:
+    StreamBuffer ();
+    ~StreamBuffer ();
+
+    void init (GLenum texture_format, std::size_t bytes);
+    void unload ();
+
+    // Wait for the current section to be free, growing the sections if they hold less than bytes, and return its memory
+    void* map (std::size_t bytes);
+    // Finish writing the current section and bind its texture to the given texture unit
+    void unmap (int texture_unit);
+    // Fence the current section once the draw calls reading it were issued and move on to the next one
+    void fence ();
+
+    inline std::size_t capacity () const {
+        return ring.size();
+    }
+    inline bool persistent () const {
+        return persistent_mapping;
+    }
+
+private:
+    SectionRing ring;
+    std::size_t mapped_size;
+    GLenum format;
+    bool persistent_mapping;
+
+    void create (std::size_t bytes);
+};
+
+}
+
+#endif // GRAPHICS_STREAM_BUFFER_H
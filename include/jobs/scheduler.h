@@ -0,0 +1,123 @@
+#ifndef JOBS_SCHEDULER_H
+#define JOBS_SCHEDULER_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace jobs {
+
+// Tracks completion of a group of jobs. Jobs may submit further jobs against the same counter.
+struct Counter {
+    std::atomic<std::size_t> pending{0};
+};
+
+// A job runs function(data, begin, end). Jobs are plain data so that submitting one never allocates.
+struct Job {
+    void (*function)(void* data, std::size_t begin, std::size_t end);
+    void* data;
+    std::size_t begin;
+    std::size_t end;
+    Counter* counter;
+};
+
+/**
+ * Work-stealing job scheduler.
+ * Every worker owns a deque: the owner pushes and pops at the back, idle workers steal from the front of other deques.
+ * The thread that calls init() is worker 0 and only runs jobs while it waits on a counter.
+ */
+class Scheduler {
+public:
+    Scheduler ();
+    ~Scheduler ();
+
+    // Start the worker threads. A value of 0 uses one worker per hardware thread.
+    void init (std::size_t num_workers = 0);
+    void term ();
+
+    void submit (const Job& job);
+
+    // Run jobs on the calling thread until all jobs tracked by counter have completed
+    void wait (Counter& counter);
+
+    // Split [0, count) into ranges of grain_size and call fn(begin, end) on each range concurrently, returns once all ranges are done
+    template <typename Fn>
+    void parallelFor (std::size_t count, std::size_t grain_size, Fn&& fn);
+
+    inline std::size_t workers () const {
+        return queues.size();
+    }
+
+    // Index of the worker running on the calling thread, threads not owned by the scheduler use worker 0's deque
+    static std::size_t workerIndex ();
+
+private:
+    static constexpr std::size_t QueueCapacity = 1024; // Must be a power of two
+
+    struct alignas(64) Queue {
+        std::mutex lock;
+        std::array<Job, QueueCapacity> jobs;
+        std::size_t head = 0; // Oldest job, thieves take from here
+        std::size_t tail = 0; // Newest job, the owner pushes and pops here
+
+        bool push (const Job& job);
+        bool pop (Job& job);
+        bool steal (Job& job);
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> threads;
+    std::atomic<bool> running;
+    std::atomic<std::size_t> queued;
+    std::mutex sleep_lock;
+    std::condition_variable wake;
+
+    bool next (std::size_t worker, Job& job);
+    void execute (const Job& job);
+    void workerLoop (std::size_t worker);
+};
+
+}
+
+template <typename Fn>
+void jobs::Scheduler::parallelFor (std::size_t count, std::size_t grain_size, Fn&& fn)
+{
+    if (count == 0) {
+        return;
+    }
+    if (grain_size == 0) {
+        grain_size = 1;
+    }
+    if (count <= grain_size || queues.size() < 2) {
+        // Not worth splitting (or nobody to split with), run inline
+        fn(std::size_t(0), count);
+        return;
+    }
+    using FnType = std::remove_reference_t<Fn>;
+    Counter counter;
+    Job job{
+        [](void* data, std::size_t begin, std::size_t end){
+            (*static_cast<FnType*>(data))(begin, end);
+        },
+        const_cast<void*>(static_cast<const void*>(std::addressof(fn))),
+        0,
+        0,
+        &counter
+    };
+    // The first range is kept for the calling thread, the rest are up for grabs
+    for (std::size_t begin = grain_size; begin < count; begin += grain_size) {
+        job.begin = begin;
+        job.end = std::min(begin + grain_size, count);
+        submit(job);
+    }
+    fn(std::size_t(0), grain_size);
+    wait(counter);
+}
+
+#endif // JOBS_SCHEDULER_H
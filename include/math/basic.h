@@ -45,9 +45,10 @@ struct frustum {
         planes[PLANE_NEAR] = glm::vec4(matrix[0][3] + matrix[0][2], matrix[1][3] + matrix[1][2], matrix[2][3] + matrix[2][2], matrix[3][3] + matrix[3][2]);
         planes[PLANE_FAR] = glm::vec4(matrix[0][3] - matrix[0][2], matrix[1][3] - matrix[1][2], matrix[2][3] - matrix[2][2], matrix[3][3] - matrix[3][2]);
 
+        // Scale by the length of the normal only, so that plane distances are in world units
         for( int i = 0; i < 6; i++ )
         {
-                planes[i] = glm::normalize(planes[i]);
+                planes[i] /= glm::length(glm::vec3(planes[i]));
         }
     }
 
@@ -1,43 +1,147 @@
 #ifndef PHYSICS_ENGINE_H
 #define PHYSICS_ENGINE_H
 
+#include <array>
+#include <cstdint>
 #include <map>
+#include <memory>
+#include <vector>
 
 #include <btBulletDynamicsCommon.h>
 #include <BulletCollision/CollisionShapes/btBox2dShape.h>
+#ifdef BT_THREADSAFE
+#include <BulletCollision/CollisionDispatch/btCollisionDispatcherMt.h>
+#include <BulletDynamics/ConstraintSolver/btSequentialImpulseConstraintSolverMt.h>
+#include <BulletDynamics/Dynamics/btDiscreteDynamicsWorldMt.h>
+#endif
 
 #include <services/core/physics.h>
+#include <physics/level.h>
+#include <physics/memory.h>
+#include <physics/motion_state.h>
+#include <physics/task_scheduler.h>
 
 namespace physics {
 
+// Broadphase algorithms, chosen per map type with [physics] broadphase
+enum class Broadphase : int {
+    Dbvt,        // Dynamic bounding volume trees, a good default and the only one queries can search concurrently
+    AxisSweep,   // Sweep and prune, at most 16383 bodies inside a fixed world size
+    AxisSweep32, // Sweep and prune with 32 bit handles, for more bodies at the cost of memory
+};
+// Parses the names used in init.toml: "dbvt", "axis-sweep" and "axis-sweep-32"
+Broadphase broadphaseFromName (const std::string& name);
+const char* broadphaseName (Broadphase broadphase);
+
 class Engine : public services::Physics {
 public:
+    Engine ();
+
     void init ();
     void term ();
 
-    
-    void stepSimulation (float delta_time) {
-        dynamicsWorld->stepSimulation(delta_time);
-    }
+
+    // Advances the world by delta_time in fixed steps of 1 / rate seconds, taking at most max_substeps of them.
+    // Time that doesn't fill a whole step carries over, and bodies are reported at positions interpolated across it.
+    // Time beyond max_substeps is dropped, so a long frame slows the simulation down rather than snowballing.
+    void setTimestep (float rate, int max_substeps);
+    void stepSimulation (float delta_time);
 
     void addBody (const ecs::entity entity, const Body& body, const Shape& shape);
     void addBodies (const std::vector<ecs::entity>& entities, const std::vector<Body>& bodies, const std::vector<Shape>& shapes);
 
     void getBodyPosition (const ecs::entity entity, glm::vec3& position);
-    void getBodyPositions (const std::vector<ecs::entity> entities, std::vector<glm::vec3>& positions);
+    void getBodyPositions (ecs::span<const ecs::entity> entities, glm::vec3* positions, std::size_t stride = sizeof(glm::vec3));
 
     void removeBody (const ecs::entity entity);
     void removeBodies (const std::vector<ecs::entity>& entities);
+
+    Moved movedBodies () const;
+
+    void raycast (ecs::span<const Ray> rays, ecs::span<RayHit> hits);
+    void overlap (ecs::span<const Sphere> spheres, ecs::span<Overlaps> results);
+    void overlap (ecs::span<const Box> boxes, ecs::span<Overlaps> results);
+    void nearest (ecs::span<const Sphere> spheres, ecs::span<Nearest> results);
+
+    // Replaces the static level geometry with the surfaces of a level file
+    void loadLevel (const std::string& config_file);
+
+    // Bodies and collision shapes currently alive, bodies with identical shape parameters share one shape
+    inline std::size_t liveBodies () const { return body_pool.live(); }
+    inline std::size_t liveShapes () const { return shape_pool.live(); }
     
 private:
     btDefaultCollisionConfiguration* collisionConfiguration;
     btCollisionDispatcher* dispatcher;
     btBroadphaseInterface* broadphase;
+    Broadphase broadphase_type;
+    float world_size; // Half extent of the space sweep and prune broadphases cover
     btSequentialImpulseConstraintSolver* solver;
     btDiscreteDynamicsWorld* dynamicsWorld;
+    float fixed_time_step;
+    int max_substeps;
+
+#ifdef BT_THREADSAFE
+    // Only used by the multithreaded world
+    std::unique_ptr<TaskScheduler> task_scheduler;
+    btConstraintSolverPoolMt* solver_pool = nullptr;
+#endif
 
-    btAlignedObjectArray<btCollisionShape*> collisionShapes;
-    std::map<ecs::entity, btRigidBody*> physics_bodies;
+    LevelCollision level;
+    btRigidBody* level_body = nullptr;
+
+    // Bodies, motion states and shapes are recycled through pools, so spawning and despawning doesn't touch the heap
+    Arena memory;
+    Pool<btRigidBody> body_pool;
+    Pool<EntityMotionState> motion_state_pool;
+
+    // Filled in by the bodies' motion states during each step
+    MovedBodies moved;
+    Pool<btBoxShape> shape_pool;
+
+    // Bodies with identical shape parameters share one collision shape, released once its last body is removed
+    using ShapeKey = std::array<float, 3>; // Box half extents
+    struct CachedShape {
+        btCollisionShape* shape;
+        std::size_t references;
+        ShapeKey key;
+    };
+    std::map<ShapeKey, CachedShape> shape_cache;
+
+    btCollisionShape* acquireShape (const Shape& shape);
+    void releaseShape (btCollisionShape* shape);
+    void destroyBody (btRigidBody* body);
+    btBroadphaseInterface* createBroadphase ();
+
+    // Calls fn(object) for every collision object whose bounding box the ray or box touches. Safe to call concurrently.
+    template <typename Fn> void forEachAlongRay (const btVector3& from, const btVector3& to, Fn&& fn) const;
+    template <typename Fn> void forEachInBox (const btVector3& min, const btVector3& max, Fn&& fn) const;
+
+    // The body's transform as last reported to its motion state, interpolated between fixed steps
+    static const btTransform& interpolatedTransform (const btRigidBody* body) {
+        return static_cast<const EntityMotionState*>(body->getMotionState())->worldTransform();
+    }
+
+    // Sparse set of bodies: body_slots is indexed by entity index and points into the densely packed arrays.
+    // Removal moves the last body into the freed slot, so the dense arrays never contain holes.
+    static constexpr std::uint32_t NoBody = std::uint32_t(-1);
+    std::vector<std::uint32_t> body_slots;
+    std::vector<ecs::entity> body_entities;
+    std::vector<btRigidBody*> bodies;
+
+    inline btRigidBody* findBody (const ecs::entity entity) const {
+        auto index = ecs::entity_index(entity);
+        if (index < body_slots.size()) {
+            auto slot = body_slots[index];
+            // Slots are keyed by index only, so check the version still matches
+            if (slot != NoBody && body_entities[slot] == entity) {
+                return bodies[slot];
+            }
+        }
+        return nullptr;
+    }
+    void insertBody (const ecs::entity entity, btRigidBody* body);
+    btRigidBody* eraseBody (const ecs::entity entity);
 };
 
 }
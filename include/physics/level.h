@@ -0,0 +1,39 @@
+#ifndef PHYSICS_LEVEL_H
+#define PHYSICS_LEVEL_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <btBulletDynamicsCommon.h>
+
+namespace physics {
+
+/**
+ * Static collision for a level, built from the same [[surface]] tables the renderer turns into tile meshes.
+ * All surfaces go into one triangle mesh shape. Building its BVH is the expensive part for large levels, so the BVH is
+ * cached in the write directory and reused for as long as the level file doesn't change.
+ */
+class LevelCollision {
+public:
+    LevelCollision ();
+    ~LevelCollision ();
+
+    void load (const std::string& config_file, const std::string& cache_file);
+    void unload ();
+
+    inline btCollisionShape* shape () const { return level_shape.get(); }
+
+private:
+    std::unique_ptr<btTriangleMesh> mesh;
+    std::unique_ptr<btBvhTriangleMeshShape> level_shape;
+    // A BVH loaded from the cache lives inside this buffer, so it must outlive the shape
+    void* bvh_buffer;
+
+    bool loadCache (const std::string& cache_file, std::uint64_t source_hash);
+    void saveCache (const std::string& cache_file, std::uint64_t source_hash);
+};
+
+}
+
+#endif // PHYSICS_LEVEL_H
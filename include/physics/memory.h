@@ -0,0 +1,91 @@
+#ifndef PHYSICS_MEMORY_H
+#define PHYSICS_MEMORY_H
+
+#include <cstddef>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <services/core/resources.h>
+
+namespace physics {
+
+/**
+ * Arena that backs all physics memory, following the services::Resources::Allocator model: allocate() reserves the
+ * first chunk up front and request() hands out blocks from it. When a chunk runs out, another one is reserved, so
+ * requests never fail. Memory is only returned by deallocate(), blocks are recycled by the pools built on top.
+ */
+class Arena : public services::Resources::Allocator {
+public:
+    explicit Arena (std::size_t chunk_bytes);
+    ~Arena ();
+
+    void allocate (std::size_t bytes);
+    void deallocate ();
+    void* request (std::size_t alignment, std::size_t size, std::size_t count);
+    void release (void* buffer);
+
+    inline std::size_t reserved () const { return total_bytes; }
+
+private:
+    std::mutex lock;
+    std::vector<void*> chunks;
+    std::size_t chunk_bytes;
+    std::size_t total_bytes;
+    char* top;
+    char* end;
+
+    void reserve (std::size_t bytes);
+};
+
+// Fixed size blocks carved out of an allocator, freed blocks are kept on a free list for reuse. Not thread safe.
+class BlockPool {
+public:
+    BlockPool (services::Resources::Allocator& allocator, std::size_t block_size, std::size_t alignment, std::size_t blocks_per_request);
+
+    void* acquire ();
+    void release (void* block);
+
+    inline std::size_t live () const { return live_blocks; }
+
+private:
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+    services::Resources::Allocator& allocator;
+    std::size_t block_size;
+    std::size_t alignment;
+    std::size_t blocks_per_request;
+    FreeBlock* free_blocks;
+    std::size_t live_blocks;
+};
+
+// Typed BlockPool that constructs and destroys the objects it hands out
+template <typename T>
+class Pool {
+public:
+    Pool (services::Resources::Allocator& allocator, std::size_t objects_per_request)
+        : blocks(allocator, sizeof(T), alignof(T) < 16 ? 16 : alignof(T), objects_per_request) {}
+
+    template <typename... Args>
+    T* create (Args&&... args) {
+        return new (blocks.acquire()) T(std::forward<Args>(args)...);
+    }
+
+    void destroy (T* object) {
+        object->~T();
+        blocks.release(object);
+    }
+
+    inline std::size_t live () const { return blocks.live(); }
+
+private:
+    BlockPool blocks;
+};
+
+// Route Bullet's internal allocations (btAlignedAlloc) through size-classed pools, must be called before creating any Bullet objects
+void installBulletAllocator ();
+
+}
+
+#endif // PHYSICS_MEMORY_H
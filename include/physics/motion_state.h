@@ -0,0 +1,82 @@
+#ifndef PHYSICS_MOTION_STATE_H
+#define PHYSICS_MOTION_STATE_H
+
+#include <atomic>
+#include <vector>
+
+#include <btBulletDynamicsCommon.h>
+#include <glm/glm.hpp>
+
+#include <ecs/types.h>
+
+namespace physics {
+
+// Bodies Bullet moved during the last step, along with their new positions
+struct MovedBodies {
+    std::vector<ecs::entity> entities;
+    std::vector<glm::vec3> positions;
+    std::atomic<std::size_t> count{0};
+
+    // Make room for every body to move, so that reporting a move never allocates
+    void reset (std::size_t num_bodies) {
+        if (entities.size() < num_bodies) {
+            entities.resize(num_bodies);
+            positions.resize(num_bodies);
+        }
+        count.store(0, std::memory_order_relaxed);
+    }
+
+    // May be called concurrently by the multithreaded world
+    void push (ecs::entity entity, const btVector3& position) {
+        auto index = count.fetch_add(1, std::memory_order_relaxed);
+        if (index >= entities.size()) {
+            // Only possible if motion states are synchronised outside of a step, the move is picked up next step
+            count.fetch_sub(1, std::memory_order_relaxed);
+            return;
+        }
+        entities[index] = entity;
+        positions[index] = glm::vec3(position.x(), position.y(), position.z());
+    }
+};
+
+/**
+ * Bullet only synchronises motion states of active bodies, so reporting moves from here means bodies at rest cost
+ * nothing when reading positions back into the ECS.
+ */
+ATTRIBUTE_ALIGNED16(class) EntityMotionState : public btMotionState {
+public:
+    BT_DECLARE_ALIGNED_ALLOCATOR();
+
+    EntityMotionState (MovedBodies& moved, ecs::entity entity, const btTransform& transform)
+        : transform(transform)
+        , moved(moved)
+        , entity(entity)
+    {}
+    virtual ~EntityMotionState () {}
+
+    ecs::entity owner () const {
+        return entity;
+    }
+
+    const btTransform& worldTransform () const {
+        return transform;
+    }
+
+    void getWorldTransform (btTransform& world_transform) const override {
+        world_transform = transform;
+    }
+
+    void setWorldTransform (const btTransform& world_transform) override {
+        transform = world_transform;
+        moved.push(entity, world_transform.getOrigin());
+    }
+
+private:
+    btTransform transform;
+    MovedBodies& moved;
+    ecs::entity entity;
+};
+
+}
+
+#endif // PHYSICS_MOTION_STATE_H
@@ -0,0 +1,41 @@
+#ifndef PHYSICS_TASK_SCHEDULER_H
+#define PHYSICS_TASK_SCHEDULER_H
+
+#ifdef BT_THREADSAFE
+
+#include <LinearMath/btThreads.h>
+
+#include <jobs/scheduler.h>
+
+namespace physics {
+
+// Runs Bullet's parallel loops on the engine's job scheduler, rather than on a second pool of threads
+class TaskScheduler : public btITaskScheduler {
+public:
+    // A thread count of 0 uses every worker of the job scheduler. Loops are split into at most num_threads ranges, but
+    // those can run on any worker, so getNumThreads() always reports the full worker count.
+    TaskScheduler (jobs::Scheduler& scheduler, int num_threads);
+
+    int getMaxNumThreads () const override;
+    int getNumThreads () const override;
+    void setNumThreads (int num_threads) override;
+    void parallelFor (int begin, int end, int grain_size, const btIParallelForBody& body) override;
+    btScalar parallelSum (int begin, int end, int grain_size, const btIParallelSumBody& body) override;
+
+    inline int rangesPerLoop () const {
+        return num_threads;
+    }
+
+private:
+    jobs::Scheduler& scheduler;
+    int num_threads; // Ranges per loop, not the number of threads that may run them
+
+    // Bullet's grain size, enlarged so that the loop is split into no more ranges than there are threads to run them
+    std::size_t grainFor (int count, int grain_size) const;
+};
+
+}
+
+#endif // BT_THREADSAFE
+
+#endif // PHYSICS_TASK_SCHEDULER_H
@@ -1,6 +1,9 @@
 #ifndef SERVICES_CORE_PHYSICS_H
 #define SERVICES_CORE_PHYSICS_H
 
+#include <array>
+#include <vector>
+
 #include <glm/glm.hpp>
 
 #include <ecs/types.h>
@@ -22,11 +25,65 @@ public:
     virtual void addBody (const ecs::entity entity, const Body& body, const Shape& shape) = 0;
     virtual void addBodies (const std::vector<ecs::entity>& entities, const std::vector<Body>& bodies, const std::vector<Shape>& shapes) = 0;
 
+    // Positions are interpolated between fixed physics steps, matching what movedBodies() reports
     virtual void getBodyPosition (const ecs::entity entity, glm::vec3& position) = 0;
-    virtual void getBodyPositions (const std::vector<ecs::entity> entities, std::vector<glm::vec3>& positions) = 0;
+    // Writes the position of each entity's body to positions, advancing by stride bytes per entity so that positions can
+    // point straight into component storage. Entities without a body are left untouched.
+    virtual void getBodyPositions (ecs::span<const ecs::entity> entities, glm::vec3* positions, std::size_t stride = sizeof(glm::vec3)) = 0;
 
     virtual void removeBody (const ecs::entity entity) = 0;
     virtual void removeBodies (const std::vector<ecs::entity>& entities) = 0;
+
+    // Entities whose bodies moved during the last simulation step, with their new positions. Sleeping bodies are never
+    // reported, so this is the set of physics entities that need their position updated.
+    struct Moved {
+        ecs::span<const ecs::entity> entities;
+        ecs::span<const glm::vec3> positions;
+    };
+    virtual Moved movedBodies () const = 0;
+
+    // Batched queries: each fills in one result per query, spread across the job scheduler's workers. They read the
+    // world as of the last step, so they must not be called while the world is being stepped.
+    struct Ray {
+        glm::vec3 from;
+        glm::vec3 to;
+    };
+    // A miss has a null entity, zero position and normal, and a fraction of 1
+    struct RayHit {
+        ecs::entity entity; // entt::null if the ray hit the level's static geometry
+        glm::vec3 position;
+        glm::vec3 normal;
+        float fraction; // Distance along the ray, from 0 at from to 1 at to
+        bool hit;
+    };
+    struct Sphere {
+        glm::vec3 center;
+        float radius;
+    };
+    struct Box {
+        glm::vec3 center;
+        glm::vec3 half_extents;
+    };
+    // Overlaps are tested against bodies' bounding boxes. Only the first MaxOverlaps entities are kept, but count
+    // includes all of them.
+    static constexpr std::size_t MaxOverlaps = 16;
+    struct Overlaps {
+        std::size_t count;
+        std::array<ecs::entity, MaxOverlaps> entities;
+    };
+    struct Nearest {
+        ecs::entity entity;
+        float distance; // From the sphere's center to the body's origin
+        bool found;
+    };
+
+    // Closest hit along each ray
+    virtual void raycast (ecs::span<const Ray> rays, ecs::span<RayHit> hits) = 0;
+    // Bodies inside each sphere or box, the level's static geometry is never reported
+    virtual void overlap (ecs::span<const Sphere> spheres, ecs::span<Overlaps> results) = 0;
+    virtual void overlap (ecs::span<const Box> boxes, ecs::span<Overlaps> results) = 0;
+    // Body closest to each sphere's center, within its radius
+    virtual void nearest (ecs::span<const Sphere> spheres, ecs::span<Nearest> results) = 0;
 };
 
 }
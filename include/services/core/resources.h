@@ -3,6 +3,7 @@
 
 #include <type_traits>
 
+#include <algorithm>
 #include <vector>
 #include <map>
 #include <atomic>
@@ -166,6 +167,8 @@ public:
         virtual void deallocate () = 0;
         virtual void* request (std::size_t alignment, std::size_t size, std::size_t count) = 0;
         virtual void release (void* buffer) = 0;
+        // Smallest alignment request() places buffers at, pools asking for less are budgeted for this much padding
+        virtual std::size_t minAlignment () const { return 1; }
     };
     struct Info {
         entt::hashed_string id;
@@ -186,7 +189,9 @@ public:
         std::size_t alignment;
         std::uint32_t type_id;
         std::size_t next_buffer;
+        std::vector<std::size_t> buffer_instances; // Instance uid handed out for each buffer, so repeated requests reuse it
     };
+    static constexpr std::size_t NoInstance = std::size_t(-1);
     struct TypeInfo {
         std::size_t size;
         std::uint32_t type_id;
@@ -224,6 +229,9 @@ public:
 
     void registerResource (Info&& info) {
         Allocator* allocator = allocators[info.allocator];
+        if (! allocator) {
+            fatal("Buffer pool {} uses an allocator that was not registered", info.id);
+        }
         switch (info.lifecycle) {
             case "stage"_hs:
                 stage_resources.push_back(info.id);
@@ -238,7 +246,7 @@ public:
         };
         info("Added {} {} buffers of {} {} each for: {}", info.num_buffers, info.lifecycle, info.size > 1024 ? info.size / 1024 : info.size, info.size > 1024 ? "KB" : "bytes", info.id);
         auto type_id = types[info.contained_type].type_id;
-        resources[info.id] = {allocator, nullptr, info.request_type, info.num_buffers, info.size, info.alignment == 0 ? 1 : info.alignment, type_id, 0};
+        resources[info.id] = {allocator, nullptr, info.request_type, info.num_buffers, info.size, std::max(info.alignment, allocator->minAlignment()), type_id, 0, {}};
     }
 
     void init (entt::hashed_string lifecycle) {
@@ -277,6 +285,7 @@ public:
             info("Requesting {} buffers of {} KB with alignment of {} bytes", entry.num_buffers, entry.buffer_size / 1024, entry.alignment);
             entry.buffers = entry.allocator->request(entry.alignment, entry.buffer_size, entry.num_buffers);
             entry.next_buffer = 0;
+            entry.buffer_instances.assign(entry.num_buffers, NoInstance);
             total_buffers += entry.num_buffers;
         }
         info("Total {} KB allocated for {} buffers", total_memory / 1024, total_buffers);
@@ -284,6 +293,7 @@ public:
 
     resources::Handle request (const entt::hashed_string& resource_id) {
         auto& entry = resources[resource_id];
+        const std::size_t buffer_index = entry.next_buffer;
         intptr_t buffer;
         switch (entry.request_type) {
             case "static"_hs:
@@ -301,6 +311,15 @@ public:
                 buffer = 0;
                 break;
         };
+        if (buffer != 0 && buffer_index < entry.buffer_instances.size()) {
+            // Buffers are requested every frame, reuse the buffer's instance rather than growing the instance table each time
+            auto& uid = entry.buffer_instances[buffer_index];
+            if (uid == NoInstance) {
+                uid = instances.size();
+                instances.push_back(ResourceInstance{resource_id.value(), entry.type_id, reinterpret_cast<void*>(buffer)});
+            }
+            return resources::Handle(uid);
+        }
         std::size_t uid = instances.size();
         instances.push_back(ResourceInstance{resource_id.value(), entry.type_id, reinterpret_cast<void*>(buffer)});
         return resources::Handle(uid);
@@ -7,6 +7,10 @@
 #include <util/helpers.h>
 #include <graphics/camera.h>
 
+namespace jobs {
+    class Scheduler;
+}
+
 namespace services {
 
 using Camera = graphics::camera;
@@ -19,6 +23,7 @@ struct locator {
     using renderer = entt::service_locator<Renderer>;
     using physics = entt::service_locator<Physics>;
     using resources = entt::service_locator<Resources>;
+    using scheduler = entt::service_locator<jobs::Scheduler>;
     template <const entt::hashed_string::hash_type Key, typename T> static T config () {return entt::monostate<Key>{};}
     template <const entt::hashed_string::hash_type Key, typename T> static void config (const T& value) {entt::monostate<Key>{} = value;}
 
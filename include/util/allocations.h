@@ -0,0 +1,31 @@
+#ifndef UTIL_ALLOCATIONS_H
+#define UTIL_ALLOCATIONS_H
+
+#include <atomic>
+#include <cstddef>
+
+// Heap allocation tracking, only active in debug builds where the global operator new is replaced to count calls
+namespace allocations {
+
+// Number of heap allocations made so far by the calling thread, always 0 in release builds
+std::size_t threadCount ();
+
+// Adds the allocations made by the calling thread while the scope is alive to total
+class Scope {
+public:
+#ifdef DEBUG_BUILD
+    explicit Scope (std::atomic<std::size_t>& total) : total(total), start(threadCount()) {}
+    ~Scope () {
+        total.fetch_add(threadCount() - start, std::memory_order_relaxed);
+    }
+private:
+    std::atomic<std::size_t>& total;
+    const std::size_t start;
+#else
+    explicit Scope (std::atomic<std::size_t>&) {}
+#endif
+};
+
+}
+
+#endif // UTIL_ALLOCATIONS_H
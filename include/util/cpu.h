@@ -0,0 +1,13 @@
+#ifndef UTIL_CPU_H
+#define UTIL_CPU_H
+
+// Runtime detection of instruction set extensions, used to pick between per-ISA kernels
+namespace cpu {
+
+bool hasSSE41 ();
+bool hasAVX2 ();
+bool hasF16C ();
+
+}
+
+#endif // UTIL_CPU_H
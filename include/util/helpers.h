@@ -46,6 +46,9 @@ void pad_with (ContainerType& container, std::size_t size, typename ContainerTyp
 
 std::string readToString(const std::string& filename);
 
+// Human readable form of a typeid name
+std::string demangle(const char* name);
+
 struct exit_scope_obj {
     template <typename Lambda>
     exit_scope_obj(Lambda& f) : func(f) {}
@@ -0,0 +1,51 @@
+#ifndef UTIL_SURFACES_H
+#define UTIL_SURFACES_H
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// The [[surface]] tables of a level file, shared by the renderer's tile meshes and the level's static collision so that
+// both always place tiles in the same spot
+namespace surfaces {
+
+struct Surface {
+    std::string imageset;
+    glm::mat4 transform; // From surface space, where each tile is a unit square on the z = 0 plane, to world space
+    std::vector<std::vector<std::int64_t>> tiles; // Rows from top to bottom, each cell is an image of the imageset
+};
+
+// Parse the [[surface]] tables of a level file's contents
+std::vector<Surface> parse (const std::string& source);
+
+// The two triangles a tile is made of, as indices into the corners passed by forEachTile
+constexpr std::array<std::size_t, 6> TileTriangles = {0, 1, 2, 2, 3, 0};
+
+// Calls fn(image, corners) for every tile, with the tile's corners in world space: top left, bottom left, bottom right
+// and top right
+template <typename Fn>
+void forEachTile (const Surface& surface, Fn&& fn)
+{
+    float row = float(surface.tiles.size());
+    for (const auto& cells : surface.tiles) {
+        float col = 0;
+        for (auto image : cells) {
+            const std::array<glm::vec3, 4> corners = {
+                glm::vec3(surface.transform * glm::vec4{col,     row,     0, 1}),
+                glm::vec3(surface.transform * glm::vec4{col,     row - 1, 0, 1}),
+                glm::vec3(surface.transform * glm::vec4{col + 1, row - 1, 0, 1}),
+                glm::vec3(surface.transform * glm::vec4{col + 1, row,     0, 1}),
+            };
+            fn(image, corners);
+            ++col;
+        }
+        --row;
+    }
+}
+
+}
+
+#endif // UTIL_SURFACES_H
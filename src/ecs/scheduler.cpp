@@ -0,0 +1,155 @@
+#include "ecs/scheduler.h"
+
+#include <sstream>
+
+#include "util/logging.h"
+
+namespace {
+
+// Returns the name of the first component that makes a and b unable to run concurrently, or an empty string
+std::string conflict (const ecs::access_set& a, const ecs::access_set& b)
+{
+    if (a.exclusive || b.exclusive) {
+        return "exclusive access";
+    }
+    for (const auto& written : a.writes) {
+        for (const auto& other : b.writes) {
+            if (written.type == other.type) {
+                return std::string("both write ") + helpers::demangle(written.name);
+            }
+        }
+        for (const auto& other : b.reads) {
+            if (written.type == other.type) {
+                return std::string("writes ") + helpers::demangle(written.name) + " which is read later";
+            }
+        }
+    }
+    for (const auto& read : a.reads) {
+        for (const auto& other : b.writes) {
+            if (read.type == other.type) {
+                return std::string("reads ") + helpers::demangle(read.name) + " which is written later";
+            }
+        }
+    }
+    return std::string{};
+}
+
+std::string describe (const std::vector<ecs::component_info>& components)
+{
+    std::ostringstream oss;
+    for (std::size_t index = 0; index < components.size(); ++index) {
+        oss << (index ? ", " : "") << helpers::demangle(components[index].name);
+    }
+    return oss.str();
+}
+
+}
+
+ecs::scheduler::scheduler ()
+    : dirty(true)
+    , current_registry(nullptr)
+    , current_jobs(nullptr)
+    , current_counter(nullptr)
+{
+
+}
+
+ecs::scheduler::~scheduler ()
+{
+
+}
+
+void ecs::scheduler::add (system* s)
+{
+    nodes.push_back({s, s->name(), s->access(), {}, {}});
+    dirty = true;
+}
+
+void ecs::scheduler::build (registry_type& registry)
+{
+    for (auto& node : nodes) {
+        node.dependencies.clear();
+        node.dependents.clear();
+    }
+    for (std::size_t later = 0; later < nodes.size(); ++later) {
+        for (std::size_t earlier = 0; earlier < later; ++earlier) {
+            auto reason = conflict(nodes[earlier].access, nodes[later].access);
+            if (! reason.empty()) {
+                nodes[later].dependencies.push_back({earlier, std::move(reason)});
+                nodes[earlier].dependents.push_back(later);
+            }
+        }
+    }
+    // Systems running concurrently must not cause the registry to create storage
+    for (auto& node : nodes) {
+        node.instance->prepare(registry);
+    }
+    remaining = std::make_unique<std::atomic<std::size_t>[]>(nodes.size());
+    dirty = false;
+    debug("System schedule:\n{}", dump());
+}
+
+void ecs::scheduler::run (registry_type& registry)
+{
+    if (dirty) {
+        build(registry);
+    }
+    if (services::locator::scheduler::empty()) {
+        for (auto& node : nodes) {
+            node.instance->run(registry);
+        }
+        return;
+    }
+    jobs::Counter counter;
+    current_registry = &registry;
+    current_jobs = &services::locator::scheduler::ref();
+    current_counter = &counter;
+    for (std::size_t index = 0; index < nodes.size(); ++index) {
+        remaining[index] = nodes[index].dependencies.size();
+    }
+    for (std::size_t index = 0; index < nodes.size(); ++index) {
+        if (nodes[index].dependencies.empty()) {
+            launch(index);
+        }
+    }
+    current_jobs->wait(counter);
+}
+
+void ecs::scheduler::launch (std::size_t index)
+{
+    current_jobs->submit({&scheduler::execute, this, index, index + 1, current_counter});
+}
+
+void ecs::scheduler::execute (void* data, std::size_t index, std::size_t)
+{
+    auto self = static_cast<scheduler*>(data);
+    auto& node = self->nodes[index];
+    node.instance->run(*self->current_registry);
+    for (auto dependent : node.dependents) {
+        if (self->remaining[dependent].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            self->launch(dependent);
+        }
+    }
+}
+
+std::string ecs::scheduler::dump () const
+{
+    std::ostringstream oss;
+    for (std::size_t index = 0; index < nodes.size(); ++index) {
+        const auto& node = nodes[index];
+        oss << "  [" << index << "] " << node.name;
+        if (node.access.exclusive) {
+            oss << " (exclusive)";
+        } else {
+            oss << " reads {" << describe(node.access.reads) << "} writes {" << describe(node.access.writes) << "}";
+        }
+        oss << "\n";
+        if (node.dependencies.empty()) {
+            oss << "      starts immediately\n";
+        }
+        for (const auto& dependency : node.dependencies) {
+            oss << "      after [" << dependency.system << "] " << nodes[dependency.system].name << ": " << dependency.reason << "\n";
+        }
+    }
+    return oss.str();
+}
@@ -0,0 +1,51 @@
+#include "ecs/systems/kinematic_integration_kernels.h"
+
+#include <cmath>
+
+#include "util/cpu.h"
+#include "util/logging.h"
+
+void ecs::systems::kernels::integrate_scalar (const kinematic_step& step, float* bodies, std::size_t body_stride, float* positions, std::size_t position_stride, std::size_t count)
+{
+    enum { X, Y, Z, Restitution };
+    for (std::size_t index = 0; index < count; ++index) {
+        float* velocity = bodies + index * body_stride;
+        float* position = positions + index * position_stride;
+        const float restitution = velocity[Restitution];
+        velocity[Y] += step.gravity * step.delta;
+        position[X] += velocity[X] * step.delta;
+        position[Y] += velocity[Y] * step.delta;
+        position[Z] += velocity[Z] * step.delta;
+        if (position[Y] < step.ground) {
+            position[Y] = step.ground;
+            velocity[Y] = std::fabs(velocity[Y]) * restitution;
+        }
+        if (position[X] < step.min_x) {
+            position[X] = step.min_x;
+            velocity[X] = std::fabs(velocity[X]) * restitution;
+        } else if (position[X] > step.max_x) {
+            position[X] = step.max_x;
+            velocity[X] = -std::fabs(velocity[X]) * restitution;
+        }
+        if (position[Z] < step.min_z) {
+            position[Z] = step.min_z;
+            velocity[Z] = std::fabs(velocity[Z]) * restitution;
+        } else if (position[Z] > step.max_z) {
+            position[Z] = step.max_z;
+            velocity[Z] = -std::fabs(velocity[Z]) * restitution;
+        }
+    }
+}
+
+ecs::systems::kernels::integrate_fn ecs::systems::kernels::select_integrate ()
+{
+    if (cpu::hasAVX2()) {
+        info("Kinematic integration using AVX2 kernel");
+        return integrate_avx2;
+    } else if (cpu::hasSSE41()) {
+        info("Kinematic integration using SSE4.1 kernel");
+        return integrate_sse41;
+    }
+    info("Kinematic integration using scalar kernel");
+    return integrate_scalar;
+}
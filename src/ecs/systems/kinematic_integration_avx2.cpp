@@ -0,0 +1,106 @@
+#include "ecs/systems/kinematic_integration_kernels.h"
+
+#include <immintrin.h>
+
+namespace {
+
+// Clamp p to at least low, reversing any velocity that points further below it
+inline void bounce_low (__m256& p, __m256& v, __m256 restitution, __m256 low)
+{
+    const __m256 hit = _mm256_cmp_ps(p, low, _CMP_LT_OQ);
+    const __m256 speed = _mm256_andnot_ps(_mm256_set1_ps(-0.0f), v);
+    p = _mm256_max_ps(p, low);
+    v = _mm256_blendv_ps(v, _mm256_mul_ps(speed, restitution), hit);
+}
+
+// Clamp p to at most high, reversing any velocity that points further above it
+inline void bounce_high (__m256& p, __m256& v, __m256 restitution, __m256 high)
+{
+    const __m256 hit = _mm256_cmp_ps(p, high, _CMP_GT_OQ);
+    const __m256 speed = _mm256_or_ps(_mm256_set1_ps(-0.0f), v); // -|v|
+    p = _mm256_min_ps(p, high);
+    v = _mm256_blendv_ps(v, _mm256_mul_ps(speed, restitution), hit);
+}
+
+// Transpose the 4x4 matrix held in each 128 bit half of a, b, c and d
+inline void transpose4 (__m256& a, __m256& b, __m256& c, __m256& d)
+{
+    const __m256 ab_low = _mm256_unpacklo_ps(a, b);
+    const __m256 ab_high = _mm256_unpackhi_ps(a, b);
+    const __m256 cd_low = _mm256_unpacklo_ps(c, d);
+    const __m256 cd_high = _mm256_unpackhi_ps(c, d);
+    a = _mm256_shuffle_ps(ab_low, cd_low, _MM_SHUFFLE(1, 0, 1, 0));
+    b = _mm256_shuffle_ps(ab_low, cd_low, _MM_SHUFFLE(3, 2, 3, 2));
+    c = _mm256_shuffle_ps(ab_high, cd_high, _MM_SHUFFLE(1, 0, 1, 0));
+    d = _mm256_shuffle_ps(ab_high, cd_high, _MM_SHUFFLE(3, 2, 3, 2));
+}
+
+inline __m256 load_pair (const float* low, const float* high)
+{
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(low)), _mm_loadu_ps(high), 1);
+}
+
+inline void store_pair (float* low, float* high, __m256 value)
+{
+    _mm_storeu_ps(low, _mm256_castps256_ps128(value));
+    _mm_storeu_ps(high, _mm256_extractf128_ps(value, 1));
+}
+
+// Load the first four floats of eight strided elements, transposed so that each register holds one field of all eight
+inline void load8 (const float* base, std::size_t stride, __m256& a, __m256& b, __m256& c, __m256& d)
+{
+    const float* high = base + 4 * stride;
+    a = load_pair(base, high);
+    b = load_pair(base + stride, high + stride);
+    c = load_pair(base + 2 * stride, high + 2 * stride);
+    d = load_pair(base + 3 * stride, high + 3 * stride);
+    transpose4(a, b, c, d);
+}
+
+// Inverse of load8
+inline void store8 (float* base, std::size_t stride, __m256 a, __m256 b, __m256 c, __m256 d)
+{
+    float* high = base + 4 * stride;
+    transpose4(a, b, c, d);
+    store_pair(base, high, a);
+    store_pair(base + stride, high + stride, b);
+    store_pair(base + 2 * stride, high + 2 * stride, c);
+    store_pair(base + 3 * stride, high + 3 * stride, d);
+}
+
+}
+
+// Processes 8 bodies per iteration, transposed into one register per axis. The remainder is handled by the scalar kernel.
+void ecs::systems::kernels::integrate_avx2 (const kinematic_step& step, float* bodies, std::size_t body_stride, float* positions, std::size_t position_stride, std::size_t count)
+{
+    const __m256 delta = _mm256_set1_ps(step.delta);
+    const __m256 gravity = _mm256_set1_ps(step.gravity * step.delta);
+    const __m256 ground = _mm256_set1_ps(step.ground);
+    const __m256 min_x = _mm256_set1_ps(step.min_x);
+    const __m256 max_x = _mm256_set1_ps(step.max_x);
+    const __m256 min_z = _mm256_set1_ps(step.min_z);
+    const __m256 max_z = _mm256_set1_ps(step.max_z);
+    std::size_t index = 0;
+    for (; index + 8 <= count; index += 8) {
+        float* b = bodies + index * body_stride;
+        float* p = positions + index * position_stride;
+        __m256 vx, vy, vz, restitution;
+        __m256 px, py, pz, pw; // pw is whatever follows each position, stored back untouched
+        load8(b, body_stride, vx, vy, vz, restitution);
+        load8(p, position_stride, px, py, pz, pw);
+
+        vy = _mm256_add_ps(vy, gravity);
+        px = _mm256_add_ps(px, _mm256_mul_ps(vx, delta));
+        py = _mm256_add_ps(py, _mm256_mul_ps(vy, delta));
+        pz = _mm256_add_ps(pz, _mm256_mul_ps(vz, delta));
+        bounce_low(py, vy, restitution, ground);
+        bounce_low(px, vx, restitution, min_x);
+        bounce_high(px, vx, restitution, max_x);
+        bounce_low(pz, vz, restitution, min_z);
+        bounce_high(pz, vz, restitution, max_z);
+
+        store8(b, body_stride, vx, vy, vz, restitution);
+        store8(p, position_stride, px, py, pz, pw);
+    }
+    integrate_scalar(step, bodies + index * body_stride, body_stride, positions + index * position_stride, position_stride, count - index);
+}
@@ -0,0 +1,80 @@
+#include "ecs/systems/kinematic_integration_kernels.h"
+
+#include <smmintrin.h>
+
+namespace {
+
+// Clamp p to at least low, reversing any velocity that points further below it
+inline void bounce_low (__m128& p, __m128& v, __m128 restitution, __m128 low)
+{
+    const __m128 hit = _mm_cmplt_ps(p, low);
+    const __m128 speed = _mm_andnot_ps(_mm_set1_ps(-0.0f), v);
+    p = _mm_max_ps(p, low);
+    v = _mm_blendv_ps(v, _mm_mul_ps(speed, restitution), hit);
+}
+
+// Clamp p to at most high, reversing any velocity that points further above it
+inline void bounce_high (__m128& p, __m128& v, __m128 restitution, __m128 high)
+{
+    const __m128 hit = _mm_cmpgt_ps(p, high);
+    const __m128 speed = _mm_or_ps(_mm_set1_ps(-0.0f), v); // -|v|
+    p = _mm_min_ps(p, high);
+    v = _mm_blendv_ps(v, _mm_mul_ps(speed, restitution), hit);
+}
+
+// Load the first four floats of four strided elements, transposed so that each register holds one field of all four
+inline void load4 (const float* base, std::size_t stride, __m128& a, __m128& b, __m128& c, __m128& d)
+{
+    a = _mm_loadu_ps(base);
+    b = _mm_loadu_ps(base + stride);
+    c = _mm_loadu_ps(base + 2 * stride);
+    d = _mm_loadu_ps(base + 3 * stride);
+    _MM_TRANSPOSE4_PS(a, b, c, d);
+}
+
+// Inverse of load4
+inline void store4 (float* base, std::size_t stride, __m128 a, __m128 b, __m128 c, __m128 d)
+{
+    _MM_TRANSPOSE4_PS(a, b, c, d);
+    _mm_storeu_ps(base, a);
+    _mm_storeu_ps(base + stride, b);
+    _mm_storeu_ps(base + 2 * stride, c);
+    _mm_storeu_ps(base + 3 * stride, d);
+}
+
+}
+
+// Processes 4 bodies per iteration, transposed into one register per axis. The remainder is handled by the scalar kernel.
+void ecs::systems::kernels::integrate_sse41 (const kinematic_step& step, float* bodies, std::size_t body_stride, float* positions, std::size_t position_stride, std::size_t count)
+{
+    const __m128 delta = _mm_set1_ps(step.delta);
+    const __m128 gravity = _mm_set1_ps(step.gravity * step.delta);
+    const __m128 ground = _mm_set1_ps(step.ground);
+    const __m128 min_x = _mm_set1_ps(step.min_x);
+    const __m128 max_x = _mm_set1_ps(step.max_x);
+    const __m128 min_z = _mm_set1_ps(step.min_z);
+    const __m128 max_z = _mm_set1_ps(step.max_z);
+    std::size_t index = 0;
+    for (; index + 4 <= count; index += 4) {
+        float* b = bodies + index * body_stride;
+        float* p = positions + index * position_stride;
+        __m128 vx, vy, vz, restitution;
+        __m128 px, py, pz, pw; // pw is whatever follows each position, stored back untouched
+        load4(b, body_stride, vx, vy, vz, restitution);
+        load4(p, position_stride, px, py, pz, pw);
+
+        vy = _mm_add_ps(vy, gravity);
+        px = _mm_add_ps(px, _mm_mul_ps(vx, delta));
+        py = _mm_add_ps(py, _mm_mul_ps(vy, delta));
+        pz = _mm_add_ps(pz, _mm_mul_ps(vz, delta));
+        bounce_low(py, vy, restitution, ground);
+        bounce_low(px, vx, restitution, min_x);
+        bounce_high(px, vx, restitution, max_x);
+        bounce_low(pz, vz, restitution, min_z);
+        bounce_high(pz, vz, restitution, max_z);
+
+        store4(b, body_stride, vx, vy, vz, restitution);
+        store4(p, position_stride, px, py, pz, pw);
+    }
+    integrate_scalar(step, bodies + index * body_stride, body_stride, positions + index * position_stride, position_stride, count - index);
+}
@@ -0,0 +1,32 @@
+#include "ecs/systems/sprite_animation_kernels.h"
+
+#include "util/cpu.h"
+#include "util/logging.h"
+
+void ecs::systems::kernels::animate_scalar (float delta, ecs::components::bitmap_animation* animations, ecs::components::sprite* sprites, std::size_t count)
+{
+    for (std::size_t index = 0; index < count; ++index) {
+        auto& animation = animations[index];
+        animation.frame_time += delta;
+        if (animation.frame_time > animation.speed) {
+            if (++animation.current_frame >= animation.max_frames) {
+                animation.current_frame = 0;
+            }
+            animation.frame_time = 0;
+        }
+        sprites[index].image = animation.base_image + animation.current_frame;
+    }
+}
+
+ecs::systems::kernels::animate_fn ecs::systems::kernels::select_animate ()
+{
+    if (cpu::hasAVX2()) {
+        info("Sprite animation using AVX2 kernel");
+        return animate_avx2;
+    } else if (cpu::hasSSE41()) {
+        info("Sprite animation using SSE4.1 kernel");
+        return animate_sse41;
+    }
+    info("Sprite animation using scalar kernel");
+    return animate_scalar;
+}
@@ -0,0 +1,42 @@
+#include "ecs/systems/sprite_animation_kernels.h"
+
+#include <immintrin.h>
+
+// Processes 8 animations per iteration, the remainder is handled by the scalar kernel
+void ecs::systems::kernels::animate_avx2 (float delta, ecs::components::bitmap_animation* animations, ecs::components::sprite* sprites, std::size_t count)
+{
+    static_assert(sizeof(ecs::components::bitmap_animation) == 5 * sizeof(float), "gather stride assumes five packed floats");
+    static_assert(sizeof(ecs::components::sprite) == sizeof(float), "sprites are stored with a single store");
+    constexpr int stride = 5;
+    const __m256i lanes = _mm256_setr_epi32(0, stride, 2 * stride, 3 * stride, 4 * stride, 5 * stride, 6 * stride, 7 * stride);
+    const __m256 delta_v = _mm256_set1_ps(delta);
+    const __m256 one_v = _mm256_set1_ps(1.0f);
+    alignas(32) float frames[8];
+    alignas(32) float times[8];
+    std::size_t index = 0;
+    for (; index + 8 <= count; index += 8) {
+        auto a = animations + index;
+        const float* fields = &a->base_image;
+        const __m256 base = _mm256_i32gather_ps(fields + 0, lanes, 4);
+        const __m256 max_frames = _mm256_i32gather_ps(fields + 1, lanes, 4);
+        const __m256 speed = _mm256_i32gather_ps(fields + 2, lanes, 4);
+        __m256 frame = _mm256_i32gather_ps(fields + 3, lanes, 4);
+        __m256 time = _mm256_i32gather_ps(fields + 4, lanes, 4);
+
+        time = _mm256_add_ps(time, delta_v);
+        const __m256 advance = _mm256_cmp_ps(time, speed, _CMP_GT_OQ);
+        __m256 next = _mm256_add_ps(frame, one_v);
+        next = _mm256_andnot_ps(_mm256_cmp_ps(next, max_frames, _CMP_GE_OQ), next); // wrap to frame 0
+        frame = _mm256_blendv_ps(frame, next, advance);
+        time = _mm256_andnot_ps(advance, time); // restart frame timer
+
+        _mm256_storeu_ps(&sprites[index].image, _mm256_add_ps(base, frame));
+        _mm256_store_ps(frames, frame);
+        _mm256_store_ps(times, time);
+        for (std::size_t lane = 0; lane < 8; ++lane) {
+            a[lane].current_frame = frames[lane];
+            a[lane].frame_time = times[lane];
+        }
+    }
+    animate_scalar(delta, animations + index, sprites + index, count - index);
+}
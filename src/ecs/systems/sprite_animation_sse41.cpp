@@ -0,0 +1,37 @@
+#include "ecs/systems/sprite_animation_kernels.h"
+
+#include <smmintrin.h>
+
+// Processes 4 animations per iteration, the remainder is handled by the scalar kernel
+void ecs::systems::kernels::animate_sse41 (float delta, ecs::components::bitmap_animation* animations, ecs::components::sprite* sprites, std::size_t count)
+{
+    const __m128 delta_v = _mm_set1_ps(delta);
+    const __m128 one_v = _mm_set1_ps(1.0f);
+    alignas(16) float frames[4];
+    alignas(16) float times[4];
+    std::size_t index = 0;
+    for (; index + 4 <= count; index += 4) {
+        auto a = animations + index;
+        const __m128 base = _mm_set_ps(a[3].base_image, a[2].base_image, a[1].base_image, a[0].base_image);
+        const __m128 max_frames = _mm_set_ps(a[3].max_frames, a[2].max_frames, a[1].max_frames, a[0].max_frames);
+        const __m128 speed = _mm_set_ps(a[3].speed, a[2].speed, a[1].speed, a[0].speed);
+        __m128 frame = _mm_set_ps(a[3].current_frame, a[2].current_frame, a[1].current_frame, a[0].current_frame);
+        __m128 time = _mm_set_ps(a[3].frame_time, a[2].frame_time, a[1].frame_time, a[0].frame_time);
+
+        time = _mm_add_ps(time, delta_v);
+        const __m128 advance = _mm_cmpgt_ps(time, speed);
+        __m128 next = _mm_add_ps(frame, one_v);
+        next = _mm_andnot_ps(_mm_cmpge_ps(next, max_frames), next); // wrap to frame 0
+        frame = _mm_blendv_ps(frame, next, advance);
+        time = _mm_andnot_ps(advance, time); // restart frame timer
+
+        _mm_storeu_ps(&sprites[index].image, _mm_add_ps(base, frame));
+        _mm_store_ps(frames, frame);
+        _mm_store_ps(times, time);
+        for (std::size_t lane = 0; lane < 4; ++lane) {
+            a[lane].current_frame = frames[lane];
+            a[lane].frame_time = times[lane];
+        }
+    }
+    animate_scalar(delta, animations + index, sprites + index, count - index);
+}
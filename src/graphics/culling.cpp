@@ -0,0 +1,39 @@
+#include "graphics/culling.h"
+
+#include "util/cpu.h"
+#include "util/logging.h"
+
+std::size_t graphics::culling::cull_scalar (const float* planes, float radius, const float* sprites, std::size_t count, float* out)
+{
+    std::size_t kept = 0;
+    for (std::size_t index = 0; index < count; ++index) {
+        const float* sprite = sprites + index * SpriteFloats;
+        bool inside = true;
+        for (std::size_t plane = 0; plane < 6; ++plane) {
+            // Outside if the sphere lies entirely behind any plane, summed in the same order as the SIMD kernels
+            const float* p = planes + plane * 4;
+            const float distance = (p[0] * sprite[0] + p[1] * sprite[1]) + (p[2] * sprite[2] + p[3]);
+            inside &= distance > -radius;
+        }
+        // out is never ahead of sprites, so copying forwards is safe when compacting in place
+        float* copy = out + kept * SpriteFloats;
+        for (std::size_t field = 0; field < SpriteFloats; ++field) {
+            copy[field] = sprite[field];
+        }
+        kept += std::size_t(inside);
+    }
+    return kept;
+}
+
+graphics::culling::cull_fn graphics::culling::select_cull ()
+{
+    if (cpu::hasAVX2()) {
+        info("Sprite culling using AVX2 kernel");
+        return cull_avx2;
+    } else if (cpu::hasSSE41()) {
+        info("Sprite culling using SSE4.1 kernel");
+        return cull_sse41;
+    }
+    info("Sprite culling using scalar kernel");
+    return cull_scalar;
+}
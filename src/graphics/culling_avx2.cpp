@@ -0,0 +1,53 @@
+#include "graphics/culling.h"
+
+#include <immintrin.h>
+
+// Processes 8 sprites per iteration, transposed into one register per axis. The remainder is handled by the scalar kernel.
+std::size_t graphics::culling::cull_avx2 (const float* planes, float radius, const float* sprites, std::size_t count, float* out)
+{
+    __m256 plane_x[6], plane_y[6], plane_z[6], plane_d[6];
+    for (std::size_t plane = 0; plane < 6; ++plane) {
+        plane_x[plane] = _mm256_set1_ps(planes[plane * 4 + 0]);
+        plane_y[plane] = _mm256_set1_ps(planes[plane * 4 + 1]);
+        plane_z[plane] = _mm256_set1_ps(planes[plane * 4 + 2]);
+        plane_d[plane] = _mm256_set1_ps(planes[plane * 4 + 3]);
+    }
+    const __m256 neg_radius = _mm256_set1_ps(-radius);
+    std::size_t kept = 0;
+    std::size_t index = 0;
+    for (; index + 8 <= count; index += 8) {
+        const float* data = sprites + index * SpriteFloats;
+        __m128 s[8];
+        for (std::size_t lane = 0; lane < 8; ++lane) {
+            s[lane] = _mm_loadu_ps(data + lane * SpriteFloats);
+        }
+        // Sprites n and n+4 share a register, so transposing within each 128 bit lane keeps them in order
+        const __m256 r0 = _mm256_insertf128_ps(_mm256_castps128_ps256(s[0]), s[4], 1);
+        const __m256 r1 = _mm256_insertf128_ps(_mm256_castps128_ps256(s[1]), s[5], 1);
+        const __m256 r2 = _mm256_insertf128_ps(_mm256_castps128_ps256(s[2]), s[6], 1);
+        const __m256 r3 = _mm256_insertf128_ps(_mm256_castps128_ps256(s[3]), s[7], 1);
+        const __m256 xy01 = _mm256_unpacklo_ps(r0, r1);
+        const __m256 xy23 = _mm256_unpacklo_ps(r2, r3);
+        const __m256 zw01 = _mm256_unpackhi_ps(r0, r1);
+        const __m256 zw23 = _mm256_unpackhi_ps(r2, r3);
+        const __m256 x = _mm256_shuffle_ps(xy01, xy23, _MM_SHUFFLE(1, 0, 1, 0));
+        const __m256 y = _mm256_shuffle_ps(xy01, xy23, _MM_SHUFFLE(3, 2, 3, 2));
+        const __m256 z = _mm256_shuffle_ps(zw01, zw23, _MM_SHUFFLE(1, 0, 1, 0));
+
+        __m256 outside = _mm256_setzero_ps();
+        for (std::size_t plane = 0; plane < 6; ++plane) {
+            const __m256 distance = _mm256_add_ps(
+                _mm256_add_ps(_mm256_mul_ps(x, plane_x[plane]), _mm256_mul_ps(y, plane_y[plane])),
+                _mm256_add_ps(_mm256_mul_ps(z, plane_z[plane]), plane_d[plane]));
+            outside = _mm256_or_ps(outside, _mm256_cmp_ps(distance, neg_radius, _CMP_LE_OQ));
+        }
+        // One bit per sprite, set when visible. Each sprite is a single 16 byte store, the next one overwrites it if culled.
+        // All eight were loaded already, so this is safe when compacting in place.
+        const int mask = _mm256_movemask_ps(outside) ^ 0xFF;
+        for (std::size_t lane = 0; lane < 8; ++lane) {
+            _mm_storeu_ps(out + kept * SpriteFloats, s[lane]);
+            kept += (mask >> lane) & 1;
+        }
+    }
+    return kept + cull_scalar(planes, radius, sprites + index * SpriteFloats, count - index, out + kept * SpriteFloats);
+}
@@ -0,0 +1,47 @@
+#include "graphics/culling.h"
+
+#include <smmintrin.h>
+
+// Processes 4 sprites per iteration, transposed into one register per axis. The remainder is handled by the scalar kernel.
+std::size_t graphics::culling::cull_sse41 (const float* planes, float radius, const float* sprites, std::size_t count, float* out)
+{
+    __m128 plane_x[6], plane_y[6], plane_z[6], plane_d[6];
+    for (std::size_t plane = 0; plane < 6; ++plane) {
+        plane_x[plane] = _mm_set1_ps(planes[plane * 4 + 0]);
+        plane_y[plane] = _mm_set1_ps(planes[plane * 4 + 1]);
+        plane_z[plane] = _mm_set1_ps(planes[plane * 4 + 2]);
+        plane_d[plane] = _mm_set1_ps(planes[plane * 4 + 3]);
+    }
+    const __m128 neg_radius = _mm_set1_ps(-radius);
+    std::size_t kept = 0;
+    std::size_t index = 0;
+    for (; index + 4 <= count; index += 4) {
+        const float* data = sprites + index * SpriteFloats;
+        const __m128 s0 = _mm_loadu_ps(data);
+        const __m128 s1 = _mm_loadu_ps(data + SpriteFloats);
+        const __m128 s2 = _mm_loadu_ps(data + 2 * SpriteFloats);
+        const __m128 s3 = _mm_loadu_ps(data + 3 * SpriteFloats);
+        __m128 x = s0, y = s1, z = s2, w = s3;
+        _MM_TRANSPOSE4_PS(x, y, z, w); // w now holds the images, which aren't needed
+
+        __m128 outside = _mm_setzero_ps();
+        for (std::size_t plane = 0; plane < 6; ++plane) {
+            const __m128 distance = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(x, plane_x[plane]), _mm_mul_ps(y, plane_y[plane])),
+                _mm_add_ps(_mm_mul_ps(z, plane_z[plane]), plane_d[plane]));
+            outside = _mm_or_ps(outside, _mm_cmple_ps(distance, neg_radius));
+        }
+        // One bit per sprite, set when visible. Each sprite is a single 16 byte store, the next one overwrites it if culled.
+        // All four were loaded already, so this is safe when compacting in place.
+        const int mask = _mm_movemask_ps(outside) ^ 0xF;
+        _mm_storeu_ps(out + kept * SpriteFloats, s0);
+        kept += mask & 1;
+        _mm_storeu_ps(out + kept * SpriteFloats, s1);
+        kept += (mask >> 1) & 1;
+        _mm_storeu_ps(out + kept * SpriteFloats, s2);
+        kept += (mask >> 2) & 1;
+        _mm_storeu_ps(out + kept * SpriteFloats, s3);
+        kept += (mask >> 3) & 1;
+    }
+    return kept + cull_scalar(planes, radius, sprites + index * SpriteFloats, count - index, out + kept * SpriteFloats);
+}
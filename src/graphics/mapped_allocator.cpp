@@ -0,0 +1,115 @@
+#include <algorithm>
+#include <cstdlib>
+
+#include "graphics/mapped_allocator.h"
+#include "util/helpers.h"
+
+#include "util/logging.h"
+
+namespace {
+// Regions hold GPU instance data read as vec4s, so never place them less aligned than that
+constexpr std::size_t MinAlignment = sizeof(glm::vec4);
+}
+
+graphics::MappedBufferAllocator::MappedBufferAllocator (GLenum texture_format)
+    : base(nullptr)
+    , section_size(0)
+    , top(0)
+    , format(texture_format)
+    , mapped(false)
+{
+
+}
+
+graphics::MappedBufferAllocator::~MappedBufferAllocator ()
+{
+
+}
+
+void graphics::MappedBufferAllocator::allocate (std::size_t bytes)
+{
+    mapped = GLEW_ARB_buffer_storage;
+    section_size = bytes;
+    top = 0;
+    if (! mapped) {
+        warn("ARB_buffer_storage is not supported, GPU buffers fall back to host memory and are copied when drawn");
+        base = static_cast<char*>(std::malloc(bytes));
+        return;
+    }
+    // Buffers are read back by the CPU (sprites are culled in place), asking for read access and client storage makes
+    // drivers place them in cached system memory rather than write-combined memory, which is very slow to read
+    ring.create(format, bytes, GL_MAP_READ_BIT | GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT, GL_CLIENT_STORAGE_BIT);
+    base = static_cast<char*>(ring.current().memory);
+    info("Mapped {} GPU buffer sections of {} KB", SectionRing::Sections, bytes / 1024);
+}
+
+void graphics::MappedBufferAllocator::deallocate ()
+{
+    if (mapped) {
+        ring.destroy();
+    } else {
+        std::free(base);
+    }
+    base = nullptr;
+    for (auto header : headers) {
+        std::free(header);
+    }
+    headers.clear();
+    placements.clear();
+}
+
+std::size_t graphics::MappedBufferAllocator::minAlignment () const
+{
+    return MinAlignment;
+}
+
+void* graphics::MappedBufferAllocator::request (std::size_t alignment, std::size_t size, std::size_t count)
+{
+    // The headers are read and written by the CPU all the time, so they stay in host memory and only the data is mapped
+    auto memory = std::malloc(sizeof(resources::MemoryBuffer) * count);
+    headers.push_back(memory);
+    auto membufs = reinterpret_cast<resources::MemoryBuffer*>(memory);
+    for (std::size_t index = 0; index < count; ++index) {
+        const std::size_t offset = helpers::align(top, std::max(alignment, MinAlignment));
+        if (offset + size > section_size) {
+            fatal("GPU buffer allocator out of space: {} bytes requested at offset {}, {} available", size, offset, section_size);
+        }
+        resources::MemoryBuffer* membuf = membufs + index;
+        const_cast<std::size_t&>(membuf->capacity) = size;
+        const_cast<void*&>(membuf->data) = base + offset;
+        membuf->count = 0;
+        placements.push_back({membuf, offset});
+        top = offset + size;
+    }
+    return memory;
+}
+
+void graphics::MappedBufferAllocator::release (void* buffer)
+{
+
+}
+
+bool graphics::MappedBufferAllocator::contains (const void* data) const
+{
+    auto pointer = static_cast<const char*>(data);
+    return mapped && pointer >= base && pointer < base + section_size;
+}
+
+graphics::MappedBufferAllocator::Region graphics::MappedBufferAllocator::region (const void* data) const
+{
+    return {ring.current().texture, std::size_t(static_cast<const char*>(data) - base)};
+}
+
+void graphics::MappedBufferAllocator::advance ()
+{
+    trace_fn();
+    if (! mapped) {
+        return;
+    }
+    ring.fence();
+    ring.wait();
+    base = static_cast<char*>(ring.current().memory);
+    for (auto& placement : placements) {
+        const_cast<void*&>(placement.buffer->data) = base + placement.offset;
+    }
+}
@@ -1,7 +1,4 @@
 
-#include <sstream>
-
-#include <cpptoml.h>
 #include <entt/entt.hpp>
 
 #include "graphics/renderer.h"
@@ -17,40 +14,15 @@
 #include "graphics/renderer.h"
 
 #include "util/logging.h"
+#include "util/surfaces.h"
 
 std::vector<graphics::Surface> loadLevel (const graphics::Imagesets& imagesets, const std::string& config_file)
 {
     graphics::generators::SurfacesGen generator(imagesets);
-    try {
-        std::istringstream iss;
-        iss.str(helpers::readToString(config_file));
-        cpptoml::parser parser{iss};
-        std::shared_ptr<cpptoml::table> config = parser.parse();
-        auto tarr = config->get_table_array("surface");
-        for (const auto& table : *tarr) {
-            auto position = table->get_array_of<double>("position");
-            auto rotate = table->get_array_of<double>("rotate");
-            auto imageset_name = table->get_as<std::string>("imageset");
-            auto tile_data = table->get_array_of<cpptoml::array>("tiles");
-
-            auto pos = glm::vec3((*position)[0], (*position)[1], (*position)[2]);
-            glm::mat4 matrix = glm::mat4(1);
-            matrix = glm::translate(matrix, pos);
-            matrix = glm::rotate(matrix, glm::radians(float((*rotate)[0])), glm::vec3(1, 0, 0));
-            matrix = glm::rotate(matrix, glm::radians(float((*rotate)[1])), glm::vec3(0, 1, 0));
-            matrix = glm::rotate(matrix, glm::radians(float((*rotate)[2])), glm::vec3(0, 0, 1));
-
-            generator.newSurface(entt::hashed_string{imageset_name->data()}, tile_data->size());
-            for (const auto& row_data : *tile_data) {
-                auto col_data = row_data->get_array_of<int64_t>();
-                generator.addRow<int64_t>(*col_data, [&matrix](auto vec){return matrix * vec;});
-            }
-        }
-        return generator.complete();
-    }
-    catch (const cpptoml::parse_exception& e) {
-        fatal("Parsing failed: {}", e.what());
+    for (const auto& surface : surfaces::parse(helpers::readToString(config_file))) {
+        generator.addSurface(surface);
     }
+    return generator.complete();
 }
 
 void unloadLevel (std::vector<graphics::Surface>& surfaces)
@@ -61,13 +33,15 @@ void unloadLevel (std::vector<graphics::Surface>& surfaces)
     surfaces.clear();
 }
 
-graphics::Renderer::Renderer ()
+graphics::Renderer::Renderer (MappedBufferAllocator* mapped_allocator)
+    : mapped_allocator(mapped_allocator)
 {
     info("Renderer");
 }
 
 graphics::Renderer::~Renderer ()
 {
+    sprite_pool.unload();
     unloadLevel(level);
 }
 
@@ -111,7 +85,7 @@ void graphics::Renderer::init ()
     u_spritepool_view_matrix = spritepool_shader.uniform("view");
     u_spritepool_billboarding = spritepool_shader.uniform("billboarding");
 
-    sprite_pool.init(spritepool_shader, imagesets.get("characters"_hs));
+    sprite_pool.init(spritepool_shader, imagesets.get("characters"_hs), services::locator::config<"renderer.packed-sprites"_hs, bool>());
 
     info("Loading level");
     level = loadLevel(imagesets, "maps/level.toml");
@@ -193,11 +167,34 @@ void graphics::Renderer::render ()
         trace_block("draw sprite pools");
         spritepool_shader.use();
         u_spritepool_view_matrix.set(view_matrix);
+        auto in_gpu_memory = [this](const resources::MemoryBuffer& buffer) {
+            return mapped_allocator && mapped_allocator->contains(buffer.data);
+        };
+        // Sprites in host memory share one mapped instance buffer and are drawn together
+        std::size_t max_sprites = 0;
+        for (auto& handle : sprite_data) {
+            resources::MemoryBuffer& buffer = handle.mem_buffer<graphics::Sprite>();
+            if (! in_gpu_memory(buffer)) {
+                max_sprites += buffer.count;
+            }
+        }
+        sprite_pool.begin(frustum, max_sprites);
         for (auto& handle : sprite_data) {
             trace_block("draw sprites");
             resources::MemoryBuffer& buffer = handle.mem_buffer<graphics::Sprite>();
-            sprite_pool.render(reinterpret_cast<graphics::Sprite*>(buffer.data), buffer.count);
+            if (in_gpu_memory(buffer)) {
+                sprite_pool.render(mapped_allocator->region(buffer.data), reinterpret_cast<graphics::Sprite*>(buffer.data), buffer.count);
+            } else {
+                sprite_pool.add(reinterpret_cast<const graphics::Sprite*>(buffer.data), buffer.count);
+            }
             buffer.count = 0;
         }
+        sprite_pool.render();
+        if (mapped_allocator) {
+            // Buffers gathered next frame must not overwrite what the GPU is still drawing from
+            mapped_allocator->advance();
+        }
+        // Handles are submitted again every frame, clearing keeps the vector's capacity so this doesn't reallocate
+        sprite_data.clear();
     }
 }
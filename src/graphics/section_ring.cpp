@@ -0,0 +1,90 @@
+#include "graphics/section_ring.h"
+#include "graphics/debug.h"
+
+#include "util/logging.h"
+
+namespace {
+// How long to block on a fence before logging that the GPU is holding us up, in nanoseconds
+constexpr GLuint64 FenceTimeout = 1000000;
+}
+
+graphics::SectionRing::SectionRing ()
+    : sections{}
+    , index(0)
+    , section_size(0)
+{
+
+}
+
+graphics::SectionRing::~SectionRing ()
+{
+
+}
+
+void graphics::SectionRing::create (GLenum texture_format, std::size_t bytes, GLbitfield map_flags, GLbitfield storage_flags)
+{
+    for (auto& section : sections) {
+        glGenBuffers(1, &section.buffer);
+        glBindBuffer(GL_TEXTURE_BUFFER, section.buffer);
+        if (map_flags) {
+            glBufferStorage(GL_TEXTURE_BUFFER, bytes, nullptr, map_flags | storage_flags);
+            section.memory = glMapBufferRange(GL_TEXTURE_BUFFER, 0, bytes, map_flags);
+        } else {
+            glBufferData(GL_TEXTURE_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+            section.memory = nullptr;
+        }
+        glGenTextures(1, &section.texture);
+        glBindTexture(GL_TEXTURE_BUFFER, section.texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, texture_format, section.buffer);
+        section.fence = nullptr;
+    }
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    checkErrors();
+    section_size = bytes;
+    index = 0;
+}
+
+void graphics::SectionRing::destroy ()
+{
+    if (! section_size) {
+        return;
+    }
+    for (auto& section : sections) {
+        if (section.fence) {
+            glDeleteSync(section.fence);
+        }
+        if (section.memory) {
+            glBindBuffer(GL_TEXTURE_BUFFER, section.buffer);
+            glUnmapBuffer(GL_TEXTURE_BUFFER);
+        }
+        // The driver keeps the storage alive until the GPU is done with any draws that still read it
+        glDeleteTextures(1, &section.texture);
+        glDeleteBuffers(1, &section.buffer);
+        section = Section{};
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    section_size = 0;
+}
+
+void graphics::SectionRing::wait ()
+{
+    auto& section = sections[index];
+    if (section.fence) {
+        GLenum result = glClientWaitSync(section.fence, GL_SYNC_FLUSH_COMMANDS_BIT, FenceTimeout);
+        if (result == GL_TIMEOUT_EXPIRED) {
+            debug("Waiting for the GPU to release buffer section {}", index);
+            do {
+                result = glClientWaitSync(section.fence, GL_SYNC_FLUSH_COMMANDS_BIT, FenceTimeout);
+            } while (result == GL_TIMEOUT_EXPIRED);
+        }
+        glDeleteSync(section.fence);
+        section.fence = nullptr;
+    }
+}
+
+void graphics::SectionRing::fence ()
+{
+    sections[index].fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    index = (index + 1) % Sections;
+}
@@ -1,18 +1,43 @@
 #include <glm/glm.hpp>
 
-#include <type_traits>
+#include <cmath>
+#include <cstddef>
 
 #include "graphics/spritepool.h"
+#include "graphics/half.h"
 #include "graphics/debug.h"
 #include "util/helpers.h"
 
 #include "util/logging.h"
 
-#include <xmmintrin.h>
+namespace {
 
+static_assert(sizeof(graphics::Sprite) == graphics::culling::SpriteFloats * sizeof(float) && offsetof(graphics::Sprite, image) == 3 * sizeof(float),
+              "the culling kernels read sprites as position x, y, z then image");
+
+// The culling kernels take sprites and planes as plain floats
+std::size_t cull (graphics::culling::cull_fn kernel, const std::array<glm::vec4, 6>& planes, float radius, const graphics::Sprite* sprites, std::size_t count, graphics::Sprite* out)
+{
+    return kernel(&planes[0].x, radius, reinterpret_cast<const float*>(sprites), count, reinterpret_cast<float*>(out));
+}
+
+void pack (const graphics::Sprite* sprites, std::size_t count, graphics::PackedSprite* out)
+{
+    for (std::size_t index = 0; index < count; ++index) {
+        const auto& sprite = sprites[index];
+        out[index] = {{graphics::toHalf(sprite.position.x), graphics::toHalf(sprite.position.y), graphics::toHalf(sprite.position.z)}, graphics::toHalf(sprite.image)};
+    }
+}
+
+}
 
 graphics::SpritePool::SpritePool ()
-    : visibleSprites(unsigned(-1))
+    : visibleSprites(0)
+    , cull_spheres(culling::select_cull())
+    , cull_radius(0)
+    , mapped_instances(nullptr)
+    , mapped_capacity(0)
+    , packed_instances(false)
 {
 
 }
@@ -20,7 +45,7 @@ graphics::SpritePool::SpritePool ()
 graphics::SpritePool::~SpritePool () {
 }
 
-void graphics::SpritePool::init (const graphics::shader& spriteShader, int texture_unit)
+void graphics::SpritePool::init (const graphics::shader& spriteShader, int texture_unit, bool packed)
 {
     mesh.bind();
     mesh.addBuffer(std::vector<glm::vec3>{
@@ -36,16 +61,14 @@ void graphics::SpritePool::init (const graphics::shader& spriteShader, int textu
             {1.0f, 1.0f}
         });
 
-    glGenBuffers(1, &tbo);
-    glActiveTexture(GL_TEXTURE0 + 6);
-    glBindBuffer(GL_TEXTURE_BUFFER, tbo);
-    glGenTextures(1, &tbo_tex);
-    glBindTexture(GL_TEXTURE_BUFFER, tbo_tex);
-    glBufferData(GL_TEXTURE_BUFFER, sizeof(glm::vec4), nullptr, GL_STREAM_DRAW); // This will get replaced on the first update
-    glBindBuffer(GL_TEXTURE_BUFFER, 0);
-    checkErrors();
+    // Each instance is a single RGBA texel, the shader doesn't care whether it was packed as halves or not. Sections grow
+    // to fit the largest frame seen so far.
+    packed_instances = packed;
+    instances.init(packed ? GL_RGBA16F : GL_RGBA32F, instanceSize() * 1024);
+    info("Uploading {} byte sprite instances", instanceSize());
 
     u_tbo_tex = spriteShader.uniform("u_tbo_tex");
+    u_first_instance = spriteShader.uniform("u_first_instance");
     spriteShader.uniform("u_texture").set(texture_unit);
 
     checkErrors();
@@ -53,6 +76,12 @@ void graphics::SpritePool::init (const graphics::shader& spriteShader, int textu
     spriteCount = 0;
 }
 
+void graphics::SpritePool::unload ()
+{
+    instances.unload();
+    mesh.unload();
+}
+
 // TODO: avoid copying data by using some kind of quad tree or other spatially aware data structure. Also, set spriteCount as a static max on-screen limit (1k sprites?)
 void graphics::SpritePool::update (Sprite* const sprites, std::size_t num_sprites)
 {
@@ -70,134 +99,73 @@ void graphics::SpritePool::update (Sprite* const sprites, std::size_t num_sprite
 //     std::copy(sprites.begin(), sprites.end(), std::back_inserter(unsortedBuffer));
 }
 
-inline void sse_cull_spheres(std::vector<graphics::Sprite>::const_iterator sphere_data, std::size_t num_objects, std::vector<int>& culling_results, const std::array<glm::vec4, 6>& frustum_planes)
+void graphics::SpritePool::begin (const math::frustum& frustum, std::size_t max_sprites)
 {
     trace_fn();
-    typename std::aligned_storage<sizeof(std::uint32_t), 16>::type results[4];
-
-    //to optimize calculations we gather xyzw elements in separate vectors
-    __m128 zero_v = _mm_setzero_ps();
-    __m128 frustum_planes_x[6];
-    __m128 frustum_planes_y[6];
-    __m128 frustum_planes_z[6];
-    __m128 frustum_planes_d[6];
-    for (std::size_t i = 0; i < 6; ++i) {
-        frustum_planes_x[i] = _mm_set1_ps(frustum_planes[i].x);
-        frustum_planes_y[i] = _mm_set1_ps(frustum_planes[i].y);
-        frustum_planes_z[i] = _mm_set1_ps(frustum_planes[i].z);
-        frustum_planes_d[i] = _mm_set1_ps(frustum_planes[i].w);
+    // Sprites are drawn as a 1x2 quad standing on their position, so test a sphere around its center instead
+    constexpr float center_height = 1.0f;
+    cull_radius = std::sqrt(0.5f * 0.5f + center_height * center_height);
+    cull_planes = frustum.planes;
+    for (auto& plane : cull_planes) {
+        plane.w += plane.y * center_height;
     }
-    //we process 4 objects per step
-    float temp[4][4];
-    for (std::size_t i = 0; i < num_objects; i += 4) {
-        //load bounding sphere data
-        for (std::size_t j = 0; j < 4; ++j) {
-            const graphics::Sprite& sprite = *sphere_data++;
-            temp[0][j] = sprite.position.x;
-            temp[1][j] = sprite.position.y;
-            temp[2][j] = sprite.position.z;
-            temp[3][j] = 1.0f; // diameter of 2.0f
-        }
-        __m128 spheres_pos_x  = _mm_load_ps(temp[0]);
-        __m128 spheres_pos_y = _mm_load_ps(temp[1]);
-        __m128 spheres_pos_z = _mm_load_ps(temp[2]);
-        __m128 spheres_radius = _mm_load_ps(temp[3]);
-
-        __m128 spheres_neg_radius = _mm_sub_ps(zero_v, spheres_radius); // negate all elements
-        __m128 intersection_res = _mm_setzero_ps();
-        for (int j = 0; j < 6; ++j) { //plane index
-            //1. calc distance to plane dot(sphere_pos.xyz, plane.xyz) + plane.w
-            //2. if distance < sphere radius, then sphere outside frustum
-            __m128 dot_x = _mm_mul_ps(spheres_pos_x, frustum_planes_x[j]);
-            __m128 dot_y = _mm_mul_ps(spheres_pos_y, frustum_planes_y[j]);
-            __m128 dot_z = _mm_mul_ps(spheres_pos_z, frustum_planes_z[j]);
-            __m128 sum_xy = _mm_add_ps(dot_x, dot_y);
-            __m128 sum_zw = _mm_add_ps(dot_z, frustum_planes_d[j]);
-            __m128 distance_to_plane = _mm_add_ps(sum_xy, sum_zw);
-            __m128 plane_res = _mm_cmple_ps(distance_to_plane, spheres_neg_radius); //dist < -sphere_r ?
-            intersection_res = _mm_or_ps(intersection_res, plane_res); //if yes - sphere behind the plane & outside frustum
-        }
-        //store result
-        __m128i intersection_res_i = _mm_cvtps_epi32(intersection_res);
-        _mm_store_si128(reinterpret_cast<__m128i*>(&results), intersection_res_i);
-        std::uint32_t* r = reinterpret_cast<std::uint32_t*>(&results[0]);
-        for (std::size_t j = 0; j < 4; ++j) {
-            culling_results.push_back(*r++);
-        }
+    visibleSprites = 0;
+    mapped_instances = max_sprites ? instances.map(instanceSize() * max_sprites) : nullptr;
+    mapped_capacity = mapped_instances ? max_sprites : 0;
+    if (packed_instances && culled_sprites.size() < mapped_capacity) {
+        culled_sprites.resize(mapped_capacity);
     }
 }
 
-void cull_spheres (std::vector<graphics::Sprite>::const_iterator sphere_data, std::size_t num_objects, std::vector<int>& culling_results, const std::array<glm::vec4, 6>& frustum_planes)
+void graphics::SpritePool::add (const Sprite* const sprite_data, std::size_t num_sprites)
 {
-    int res;
-    for (std::size_t idx = 0; idx < num_objects; ++idx) {
-        res = 0;
-        const graphics::Sprite& sprite = *sphere_data++;
-        const glm::vec3& pos = sprite.position;
-        //test all 6 frustum planes
-        for (int i = 0; i < 6; i++)
-        {
-            //calculate distance from sphere center to plane.
-            //if distance larger then sphere radius - sphere is outside frustum
-            if (frustum_planes[i].x * pos.x + frustum_planes[i].y * pos.y + frustum_planes[i].z * pos.z + frustum_planes[i].w + 1.0f <= 0)
-                res = 1;
-        }
-        culling_results.push_back(res);
+    trace_fn();
+    if (visibleSprites + num_sprites > mapped_capacity) {
+        warn("SpritePool has room for {} more sprites but {} were added, dropping the rest", mapped_capacity - visibleSprites, num_sprites);
+        num_sprites = mapped_capacity - visibleSprites;
     }
+    if (packed_instances) {
+        // Culling writes every sprite before deciding whether to keep it, so only pack the survivors into GPU memory
+        const auto kept = cull(cull_spheres, cull_planes, cull_radius, sprite_data, num_sprites, culled_sprites.data());
+        pack(culled_sprites.data(), kept, static_cast<PackedSprite*>(mapped_instances) + visibleSprites);
+        visibleSprites += kept;
+    } else {
+        visibleSprites += cull(cull_spheres, cull_planes, cull_radius, sprite_data, num_sprites, static_cast<Sprite*>(mapped_instances) + visibleSprites);
+    }
+    spriteCount += num_sprites;
 }
 
-std::size_t graphics::SpritePool::cull_sprites (const math::frustum& frustum, std::vector<graphics::Sprite>& positions)
+void graphics::SpritePool::render ()
 {
     trace_fn();
-    // perform frustum culling and package sprite data for rendering
-    std::size_t num_objects = positions.size();
-    // make sure num_objects is multiple of 4. Pad with null objects if not.
-    while ((positions.size() & 0x3) != 0) {
-        positions.push_back({});
-    }
-    size_t num_objects_to_cull = positions.size();
-    culling_results.clear();
-    culling_results.reserve(num_objects_to_cull);
-    // sse_cull_spheres(positions.begin(), num_objects_to_cull, culling_results, frustum.planes);
-    cull_spheres(positions.begin(), num_objects_to_cull, culling_results, frustum.planes);
-    // Remove null objects, if any
-    std::size_t to_remove = positions.size() - num_objects;
-    for (std::size_t i = to_remove; i; --i) {
-        positions.pop_back();
+    if (! mapped_instances) {
+        return;
     }
-    // Remove culled sprites
-    for (std::size_t i = 0; i < num_objects; ++i) {
-        if (culling_results[i]) {
-            helpers::remove(positions, i);
-        }
-    }
-    // info("Number of sprites culled: {} of {}", num_objects - positions.size(), num_objects);
-    return positions.size();
-}
+    instances.unmap(6);
+    mapped_instances = nullptr;
+    mapped_capacity = 0;
 
+    u_tbo_tex.set(6);
+    u_first_instance.set(0);
+    mesh.draw(visibleSprites);
+    instances.fence();
+    checkErrors();
 
-void graphics::SpritePool::render (Sprite* const sprite_data, std::size_t num_sprites)
+    spriteCount = 0;
+}
+
+void graphics::SpritePool::render (const MappedBufferAllocator::Region& region, Sprite* const sprite_data, std::size_t num_sprites)
 {
-#ifdef DEBUG_BUILD
-    if (spriteCount != 0 && spriteCount < num_sprites) { // If this isn't the first update, then warn that the size has changed
-        debug("SpritePool inited for {} sprites but {} sprites updated - this may have a performance impact", spriteCount, num_sprites);
+    trace_fn();
+    // The culling kernels support compacting in place, so the visible sprites end up at the start of the region
+    const std::size_t visible = cull(cull_spheres, cull_planes, cull_radius, sprite_data, num_sprites, sprite_data);
+    if (visible == 0) {
+        return;
     }
-#endif
-
     glActiveTexture(GL_TEXTURE0 + 6);
-    glBindBuffer(GL_TEXTURE_BUFFER, tbo);
-    glBindTexture(GL_TEXTURE_BUFFER, tbo_tex);
-    // Orphan old buffer and then load data into new buffer
-    glBufferData(GL_TEXTURE_BUFFER, sizeof(glm::vec4) * spriteCount, nullptr, GL_STREAM_DRAW);
-    glBufferData(GL_TEXTURE_BUFFER, sizeof(glm::vec4) * num_sprites, reinterpret_cast<const float*>(sprite_data), GL_STREAM_DRAW);
-    glTexBuffer(GL_TEXTURE_BUFFER, GL_R32F, tbo);
-    glBindBuffer(GL_TEXTURE_BUFFER, 0);
-
-    debug("Rendering {} visible sprites ({} total)", num_sprites, spriteCount);
-
+    glBindTexture(GL_TEXTURE_BUFFER, region.texture);
     u_tbo_tex.set(6);
-    mesh.draw(num_sprites);
+    u_first_instance.set(int(region.offset / sizeof(Sprite)));
+    mesh.draw(visible);
     checkErrors();
-
-    spriteCount = num_sprites;
-}
\ No newline at end of file
+}
@@ -0,0 +1,75 @@
+#include <algorithm>
+
+#include "graphics/stream_buffer.h"
+
+#include "util/logging.h"
+
+graphics::StreamBuffer::StreamBuffer ()
+    : mapped_size(0)
+    , format(GL_R32F)
+    , persistent_mapping(false)
+{
+
+}
+
+graphics::StreamBuffer::~StreamBuffer ()
+{
+
+}
+
+void graphics::StreamBuffer::init (GLenum texture_format, std::size_t bytes)
+{
+    format = texture_format;
+    persistent_mapping = GLEW_ARB_buffer_storage;
+    info("Streaming instance data through {} {} buffers", SectionRing::Sections, persistent_mapping ? "persistently mapped" : "unsynchronized mapped");
+    create(bytes);
+}
+
+void graphics::StreamBuffer::unload ()
+{
+    ring.destroy();
+}
+
+void graphics::StreamBuffer::create (std::size_t bytes)
+{
+    ring.create(format, bytes, persistent_mapping ? GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT : 0);
+}
+
+void* graphics::StreamBuffer::map (std::size_t bytes)
+{
+    trace_fn();
+    if (bytes > ring.size()) {
+        const std::size_t grown = std::max(bytes, ring.size() * 2);
+        debug("Growing stream buffer sections from {} to {} bytes", ring.size(), grown);
+        ring.destroy();
+        create(grown);
+    }
+    ring.wait();
+    auto& section = ring.current();
+    if (persistent_mapping) {
+        return section.memory;
+    }
+    mapped_size = bytes;
+    glBindBuffer(GL_TEXTURE_BUFFER, section.buffer);
+    void* memory = glMapBufferRange(GL_TEXTURE_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    return memory;
+}
+
+void graphics::StreamBuffer::unmap (int texture_unit)
+{
+    const auto& section = ring.current();
+    if (! persistent_mapping && mapped_size) {
+        glBindBuffer(GL_TEXTURE_BUFFER, section.buffer);
+        glUnmapBuffer(GL_TEXTURE_BUFFER);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        mapped_size = 0;
+    }
+    glActiveTexture(GL_TEXTURE0 + texture_unit);
+    glBindTexture(GL_TEXTURE_BUFFER, section.texture);
+}
+
+void graphics::StreamBuffer::fence ()
+{
+    ring.fence();
+}
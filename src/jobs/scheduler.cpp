@@ -0,0 +1,155 @@
+#include "jobs/scheduler.h"
+
+#include "util/logging.h"
+
+namespace {
+    thread_local std::size_t current_worker = 0;
+}
+
+bool jobs::Scheduler::Queue::push (const Job& job)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    if (tail - head == QueueCapacity) {
+        return false;
+    }
+    jobs[tail++ & (QueueCapacity - 1)] = job;
+    return true;
+}
+
+bool jobs::Scheduler::Queue::pop (Job& job)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    if (tail == head) {
+        return false;
+    }
+    job = jobs[--tail & (QueueCapacity - 1)];
+    return true;
+}
+
+bool jobs::Scheduler::Queue::steal (Job& job)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    if (tail == head) {
+        return false;
+    }
+    job = jobs[head++ & (QueueCapacity - 1)];
+    return true;
+}
+
+jobs::Scheduler::Scheduler ()
+    : running(false)
+    , queued(0)
+{
+
+}
+
+jobs::Scheduler::~Scheduler ()
+{
+    term();
+}
+
+void jobs::Scheduler::init (std::size_t num_workers)
+{
+    if (num_workers == 0) {
+        num_workers = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    info("Starting job scheduler with {} workers", num_workers);
+    current_worker = 0;
+    running = true;
+    for (std::size_t worker = 0; worker < num_workers; ++worker) {
+        queues.push_back(std::make_unique<Queue>());
+    }
+    // Worker 0 is the calling thread
+    for (std::size_t worker = 1; worker < num_workers; ++worker) {
+        threads.emplace_back([this, worker](){ workerLoop(worker); });
+    }
+}
+
+void jobs::Scheduler::term ()
+{
+    if (! running) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> guard(sleep_lock);
+        running = false;
+    }
+    wake.notify_all();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    threads.clear();
+    queues.clear();
+}
+
+std::size_t jobs::Scheduler::workerIndex ()
+{
+    return current_worker;
+}
+
+void jobs::Scheduler::submit (const Job& job)
+{
+    job.counter->pending.fetch_add(1, std::memory_order_relaxed);
+    queued.fetch_add(1, std::memory_order_release);
+    if (! queues[current_worker]->push(job)) {
+        // Deque is full, run the job immediately instead
+        queued.fetch_sub(1, std::memory_order_relaxed);
+        execute(job);
+        return;
+    }
+    {
+        // Synchronise with workers that are about to sleep, so that the wakeup cannot be missed
+        std::lock_guard<std::mutex> guard(sleep_lock);
+    }
+    wake.notify_one();
+}
+
+void jobs::Scheduler::wait (Counter& counter)
+{
+    const std::size_t worker = current_worker;
+    Job job;
+    while (counter.pending.load(std::memory_order_acquire) > 0) {
+        if (next(worker, job)) {
+            execute(job);
+        } else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+bool jobs::Scheduler::next (std::size_t worker, Job& job)
+{
+    if (queues[worker]->pop(job)) {
+        queued.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+    // Own deque is empty, try to steal from the other workers
+    const std::size_t num_queues = queues.size();
+    for (std::size_t offset = 1; offset < num_queues; ++offset) {
+        if (queues[(worker + offset) % num_queues]->steal(job)) {
+            queued.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+void jobs::Scheduler::execute (const Job& job)
+{
+    job.function(job.data, job.begin, job.end);
+    job.counter->pending.fetch_sub(1, std::memory_order_release);
+}
+
+void jobs::Scheduler::workerLoop (std::size_t worker)
+{
+    current_worker = worker;
+    Job job;
+    while (running) {
+        if (next(worker, job)) {
+            execute(job);
+        } else {
+            std::unique_lock<std::mutex> guard(sleep_lock);
+            wake.wait(guard, [this](){ return ! running || queued.load(std::memory_order_acquire) > 0; });
+        }
+    }
+}
@@ -29,11 +29,15 @@
 #include "graphics/camera.h"
 #include "graphics/imagesets.h"
 #include "graphics/spritepool.h"
+#include "graphics/mapped_allocator.h"
 #include "graphics/renderer.h"
 
+#include "ecs/scheduler.h"
 #include "ecs/systems/sprite_render.h"
 #include "ecs/systems/sprite_animation.h"
 #include "ecs/systems/physics_simulation.h"
+#include "ecs/systems/kinematic_integration.h"
+#include "ecs/systems/position_snapshot.h"
 
 #include "services/locator.h"
 #include "services/core/resources.h"
@@ -42,6 +46,8 @@
 
 #include "physics/engine.h"
 
+#include "jobs/scheduler.h"
+
 struct BufferAllocator : public services::Resources::Allocator {
     void allocate (std::size_t bytes) {
         memory = reinterpret_cast<intptr_t>(std::malloc(bytes));
@@ -95,14 +101,25 @@ void setupPhysFS (const char* argv0, std::vector<std::string> sourcePaths)
             PhysFS::mount(path, "/", 1);
         }
     }
+    // Generated data (such as the static collision cache) is written to the user's preferences directory
+    if (auto pref_dir = PHYSFS_getPrefDir("Dan Kersten", "BloodFarmers")) {
+        if (PHYSFS_setWriteDir(pref_dir)) {
+            debug("Writing generated files to {}", pref_dir);
+            PhysFS::mount(pref_dir, "/", 1);
+        } else {
+            warn("Could not use {} as write directory, generated files will not be cached", pref_dir);
+        }
+    }
 }
 
-void setupTypes ()
+void setupTypes (graphics::MappedBufferAllocator* mapped_allocator)
 {
     auto& resources = services::locator::resources::ref();
     
     // Register allocators
     resources.registerAllocator("buffer-allocator"_hs, new BufferAllocator());
+    // Without a GL context (headless runs) pools asking for GPU memory get host memory instead
+    resources.registerAllocator("gpu-buffer-allocator"_hs, mapped_allocator ? static_cast<services::Resources::Allocator*>(mapped_allocator) : new BufferAllocator());
 
     // Register types
     resources.registerType<services::Resources::InvalidType>("invalid-type"_hs);
@@ -128,6 +145,7 @@ void setupBuffers (const std::string& config_file)
             auto alignment = buffer->get_as<int64_t>("alignment");
             auto size = buffer->get_as<int64_t>("size");
             auto units = buffer->get_as<std::string>("units");
+            auto allocator = table->get_as<std::string>("allocator").value_or("buffer-allocator");
 
             std::uint32_t num_bytes = *size;
             std::uint32_t element_size = resources.sizeOf(entt::hashed_string{type->data()});
@@ -146,7 +164,7 @@ void setupBuffers (const std::string& config_file)
                 entt::hashed_string{id->data()},        // id
                 entt::hashed_string{lifecycle->data()}, // lifecycle
                 entt::hashed_string{requests->data()},  // request_type
-                "buffer-allocator"_hs,                  // allocator
+                entt::hashed_string{allocator.data()},  // allocator
                 entt::hashed_string{type->data()},      // contained_type
                 std::uint32_t(*alignment),              // buffer alignment
                 num_bytes,                              // size
@@ -162,6 +180,22 @@ void setupBuffers (const std::string& config_file)
 struct Settings {
     std::vector<std::string> sources;
     std::string log_level;
+    std::size_t worker_threads;
+    float tick_rate;
+    std::size_t max_ticks_per_frame;
+    std::size_t entities;
+    std::size_t kinematic_entities;
+    int physics_threads;
+    float physics_rate;
+    int physics_max_substeps;
+    physics::Broadphase physics_broadphase;
+    float physics_world_size;
+    bool packed_sprites;
+
+    // Headless runs simulate without a window or renderer, for a number of ticks and/or a wall-clock duration
+    bool headless;
+    std::size_t ticks;
+    float duration;
 
     bool start;
 };
@@ -176,7 +210,12 @@ Settings readSettings (int argc, char* argv[])
         ("p,profiling", "Enable profiling")
 #endif
         ("l,loglevel", "Log level", cxxopts::value<std::string>())
-        ("i,init", "Initialisation file", cxxopts::value<std::string>()->default_value("init.toml"));
+        ("i,init", "Initialisation file", cxxopts::value<std::string>()->default_value("init.toml"))
+        ("e,entities", "Number of entities to generate", cxxopts::value<std::size_t>()->default_value("10"))
+        ("k,kinematic", "Number of kinematic entities to generate, which bypass the physics engine", cxxopts::value<std::size_t>()->default_value("0"))
+        ("headless", "Run the simulation without a window or renderer and report ticks per second")
+        ("ticks", "Number of ticks to simulate in headless mode", cxxopts::value<std::size_t>()->default_value("0"))
+        ("duration", "Seconds to simulate for in headless mode", cxxopts::value<float>()->default_value("0"));
     auto result = options.parse(argc, argv);
 
     auto config = cpptoml::parse_file(result["init"].as<std::string>());
@@ -191,6 +230,43 @@ Settings readSettings (int argc, char* argv[])
     for (const auto& source : *sources) {
         settings.sources.push_back(source);
     }
+    auto engine = config->get_table("engine");
+    // 0 uses one worker per hardware thread
+    const int64_t worker_threads = engine ? engine->get_as<int64_t>("worker_threads").value_or(0) : 0;
+    if (worker_threads < 0) {
+        fatal("engine.worker_threads must not be negative, use 0 for one worker per hardware thread");
+    }
+    settings.worker_threads = std::size_t(worker_threads);
+    settings.tick_rate = engine ? float(engine->get_as<double>("tick_rate").value_or(60.0)) : 60.0f;
+    settings.max_ticks_per_frame = engine ? std::size_t(engine->get_as<int64_t>("max_ticks_per_frame").value_or(5)) : 5;
+    auto physics = config->get_table("physics");
+    settings.physics_threads = physics ? int(physics->get_as<int64_t>("threads").value_or(1)) : 1;
+    // Physics steps at the tick rate unless configured otherwise
+    settings.physics_rate = physics ? float(physics->get_as<double>("rate").value_or(settings.tick_rate)) : settings.tick_rate;
+    settings.physics_max_substeps = physics ? int(physics->get_as<int64_t>("max_substeps").value_or(4)) : 4;
+    settings.physics_broadphase = physics::broadphaseFromName(physics ? physics->get_as<std::string>("broadphase").value_or("dbvt") : "dbvt");
+    settings.physics_world_size = physics ? float(physics->get_as<double>("world_size").value_or(1000.0)) : 1000.0f;
+    auto graphics = config->get_table("graphics");
+    settings.packed_sprites = graphics ? graphics->get_as<bool>("packed_sprites").value_or(false) : false;
+    settings.entities = result["entities"].as<std::size_t>();
+    settings.kinematic_entities = result["kinematic"].as<std::size_t>();
+    settings.headless = result["headless"].count() > 0;
+    settings.ticks = result["ticks"].as<std::size_t>();
+    settings.duration = result["duration"].as<float>();
+    if (settings.headless && settings.ticks == 0 && settings.duration <= 0.0f) {
+        // Without a limit, default to a ten second run
+        settings.duration = 10.0f;
+    }
+    if (settings.tick_rate <= 0.0f || settings.max_ticks_per_frame == 0) {
+        fatal("engine.tick_rate and engine.max_ticks_per_frame must be greater than zero");
+    }
+    if (settings.physics_rate <= 0.0f || settings.physics_max_substeps < 1) {
+        fatal("physics.rate and physics.max_substeps must be greater than zero");
+    }
+    if (settings.physics_rate > settings.tick_rate * float(settings.physics_max_substeps)) {
+        warn("physics.rate of {} needs more than physics.max_substeps ({}) steps per tick, the simulation will run slow",
+             settings.physics_rate, settings.physics_max_substeps);
+    }
     return settings;
 }
 
@@ -208,113 +284,176 @@ int main (int argc, char* argv[])
     logging::init(settings.log_level);
     setupPhysFS(argv[0], settings.sources);
     try {
-        if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_GAMECONTROLLER) < 0)
-        {
-            fatal("Failed to initialise SDL");
-        }
-        on_exit_scope = [](){ SDL_Quit(); };
-        
-        // Set the OpenGL attributes for our context
-        SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
-        SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 4);
-        SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 1);
-        SDL_GL_SetAttribute(SDL_GL_RED_SIZE, 8);
-        SDL_GL_SetAttribute(SDL_GL_GREEN_SIZE, 8);
-        SDL_GL_SetAttribute(SDL_GL_BLUE_SIZE, 8);
-        SDL_GL_SetAttribute(SDL_GL_ALPHA_SIZE, 8);
-        SDL_GL_SetAttribute(SDL_GL_BUFFER_SIZE, 32);
-        SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 16);
-        SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
-        SDL_GL_SetAttribute(SDL_GL_ACCELERATED_VISUAL, 1);
-        SDL_GL_SetAttribute(SDL_GL_MULTISAMPLEBUFFERS, 1);
-        SDL_GL_SetAttribute(SDL_GL_MULTISAMPLESAMPLES, 4);
-
-        // Create a centered window, using system configuration
-        auto window = helpers::ptr<SDL_Window>(SDL_CreateWindow, SDL_DestroyWindow).construct(
-                    "BloodFarm",
-                    SDL_WINDOWPOS_CENTERED,
-                    SDL_WINDOWPOS_CENTERED,
-                    640,
-                    480,
-                    SDL_WINDOW_OPENGL);
-        
-        SDL_GLContext context = SDL_GL_CreateContext(window.get());
-        on_exit_scope = [&context](){ SDL_GL_DeleteContext(context); };
-        info("Created window with OpenGL {}", glGetString(GL_VERSION));
-
-	SDL_GL_SetSwapInterval(0);
+        std::unique_ptr<SDL_Window, void(*)(SDL_Window*)> window(nullptr, SDL_DestroyWindow);
+        SDL_GLContext context = nullptr;
+        SDL_GameController* gameController = nullptr;
+        on_exit_scope = [&settings, &window, &context](){
+            if (! settings.headless) {
+                if (context) {
+                    SDL_GL_DeleteContext(context);
+                }
+                window.reset();
+                SDL_Quit();
+            }
+        };
+        // Headless runs only simulate, so they need neither a window nor a GL context
+        if (! settings.headless) {
+            if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_GAMECONTROLLER) < 0)
+            {
+                fatal("Failed to initialise SDL");
+            }
 
-        // Load OpenGL 3+ functions
-        glewExperimental = GL_TRUE;
-        glewInit();
+            // Set the OpenGL attributes for our context
+            SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+            SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 4);
+            SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 1);
+            SDL_GL_SetAttribute(SDL_GL_RED_SIZE, 8);
+            SDL_GL_SetAttribute(SDL_GL_GREEN_SIZE, 8);
+            SDL_GL_SetAttribute(SDL_GL_BLUE_SIZE, 8);
+            SDL_GL_SetAttribute(SDL_GL_ALPHA_SIZE, 8);
+            SDL_GL_SetAttribute(SDL_GL_BUFFER_SIZE, 32);
+            SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 16);
+            SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
+            SDL_GL_SetAttribute(SDL_GL_ACCELERATED_VISUAL, 1);
+            SDL_GL_SetAttribute(SDL_GL_MULTISAMPLEBUFFERS, 1);
+            SDL_GL_SetAttribute(SDL_GL_MULTISAMPLESAMPLES, 4);
+
+            // Create a centered window, using system configuration
+            window = helpers::ptr<SDL_Window>(SDL_CreateWindow, SDL_DestroyWindow).construct(
+                        "BloodFarm",
+                        SDL_WINDOWPOS_CENTERED,
+                        SDL_WINDOWPOS_CENTERED,
+                        640,
+                        480,
+                        SDL_WINDOW_OPENGL);
+
+            context = SDL_GL_CreateContext(window.get());
+            info("Created window with OpenGL {}", glGetString(GL_VERSION));
+
+            SDL_GL_SetSwapInterval(0);
+
+            // Load OpenGL 3+ functions
+            glewExperimental = GL_TRUE;
+            glewInit();
 
-        SDL_GameController* gameController;
-        {
-            std::string controllerMapping = helpers::readToString("gamecontrollerdb.txt");
-            if (SDL_GameControllerAddMappingsFromRW(SDL_RWFromMem(controllerMapping.data(), controllerMapping.size()), 0) < 0) {
-                fatal("Could not read gamepad mapping database.");
-            } 
+            {
+                std::string controllerMapping = helpers::readToString("gamecontrollerdb.txt");
+                if (SDL_GameControllerAddMappingsFromRW(SDL_RWFromMem(controllerMapping.data(), controllerMapping.size()), 0) < 0) {
+                    fatal("Could not read gamepad mapping database.");
+                }
+            }
         }
 
         // auto myNoise = helpers::ptr<FastNoiseSIMD>(FastNoiseSIMD::NewFastNoiseSIMD).construct(1337);
         // auto noiseSet = helpers::ptr<float>(myNoise->GetSimplexFractalSet(0, 0, 0, 16, 16, 16));
 
+        info("Creating job scheduler");
+        auto scheduler = std::make_shared<jobs::Scheduler>();
+        scheduler->init(settings.worker_threads);
+        services::locator::scheduler::set(scheduler);
+
         info("Creating resources service");
         services::locator::resources::set<services::Resources>();
-        setupTypes();
+        // Sprite instances are read by the shader as one RGBA32F texel each
+        auto mapped_allocator = settings.headless ? nullptr : new graphics::MappedBufferAllocator(GL_RGBA32F);
+        setupTypes(mapped_allocator);
         setupBuffers("buffers.toml");
         services::locator::resources::ref().init("static"_hs);
         
-        info("Creating rendeding service");
-        auto renderer = std::make_shared<graphics::Renderer>();
-        services::locator::renderer::set(std::shared_ptr<services::Renderer>(renderer));
+        std::shared_ptr<graphics::Renderer> renderer;
+        if (! settings.headless) {
+            info("Creating rendeding service");
+            renderer = std::make_shared<graphics::Renderer>(mapped_allocator);
+            services::locator::renderer::set(std::shared_ptr<services::Renderer>(renderer));
+        }
         services::locator::camera::set<services::Camera>();
 
         info("Creating physics service");
         auto physicsEngine = std::make_shared<physics::Engine>();
         services::locator::physics::set(std::shared_ptr<services::Physics>(physicsEngine));
 
+        services::locator::config<"physics.threads"_hs, int>(settings.physics_threads);
+        services::locator::config<"physics.rate"_hs, float>(settings.physics_rate);
+        services::locator::config<"physics.max-substeps"_hs, int>(settings.physics_max_substeps);
+        services::locator::config<"physics.broadphase"_hs, int>(int(settings.physics_broadphase));
+        services::locator::config<"physics.world-size"_hs, float>(settings.physics_world_size);
+        // Read by Renderer::init, unlike the other renderer settings which are only needed once the window exists
+        services::locator::config<"renderer.packed-sprites"_hs, bool>(settings.packed_sprites);
+
         info("Initialising services");
-        initServices(physicsEngine, renderer);
+        if (settings.headless) {
+            initServices(physicsEngine);
+        } else {
+            initServices(physicsEngine, renderer);
+
+            info("Setting renderer config");
+            services::locator::config<"renderer.field-of-view"_hs, float>(60.0f);
+            services::locator::config<"renderer.near-distance"_hs, float>(0.1f);
+            services::locator::config<"renderer.far-distance"_hs, float>(100.0f);
+            services::locator::config<"renderer.width"_hs, float>(640.0f);
+            services::locator::config<"renderer.height"_hs, float>(480.0f);
+            renderer->windowChanged();
+        }
 
-        info("Setting renderer config");
-        services::locator::config<"renderer.field-of-view"_hs, float>(60.0f);
-        services::locator::config<"renderer.near-distance"_hs, float>(0.1f);
-        services::locator::config<"renderer.far-distance"_hs, float>(100.0f);
-        services::locator::config<"renderer.width"_hs, float>(640.0f);
-        services::locator::config<"renderer.height"_hs, float>(480.0f);
-        renderer->windowChanged();
+        // Static collision for the same level the renderer draws
+        if (PhysFS::exists("maps/level.toml")) {
+            info("Loading level collision");
+            physicsEngine->loadLevel("maps/level.toml");
+        } else {
+            warn("No level found, the physics world has no static collision");
+        }
 
         info("Initialising game systems");
         ecs::registry_type registry;
+        auto position_snapshot_system = new ecs::systems::position_snapshot;
         auto physics_simulation_system = new ecs::systems::physics_simulation;
+        auto kinematic_integration_system = new ecs::systems::kinematic_integration(1.0f / settings.tick_rate);
+        // Same area entities are generated in
+        kinematic_integration_system->setBounds(glm::vec3(-50.0f, 0.0f, -100.0f), glm::vec3(50.0f, 0.0f, 0.0f));
         auto sprite_animation_system = new ecs::systems::sprite_animation;
-        auto sprite_render_system = new ecs::systems::sprite_render;
-        auto systems = std::vector<ecs::system*>{
-            physics_simulation_system,
-            sprite_animation_system,
-            sprite_render_system,
-        };
+        auto sprite_render_system = settings.headless ? nullptr : new ecs::systems::sprite_render;
+        // Systems that touch the same components run in this order, others run concurrently
+        // Simulation systems run once per fixed tick, presentation systems once per rendered frame
+        ecs::scheduler simulation;
+        simulation.add(position_snapshot_system);
+        simulation.add(physics_simulation_system);
+        simulation.add(kinematic_integration_system);
+        simulation.add(sprite_animation_system);
+        ecs::scheduler presentation;
+        if (sprite_render_system) {
+            presentation.add(sprite_render_system);
+        }
 
-        info("Generating entities");
+        info("Generating {} entities and {} kinematic entities", settings.entities, settings.kinematic_entities);
         {
+            // Headless runs are used as benchmarks, so they always generate the same world
             std::random_device rd;
-            std::mt19937 mt(rd());
+            std::mt19937 mt(settings.headless ? 0u : rd());
             std::uniform_real_distribution<float> dist(-50.0f, 50.0f);
             std::uniform_int_distribution<int> rnd(0, 32);
-            for (unsigned i=0; i<10; ++i) {
+            for (std::size_t i=0; i<settings.entities; ++i) {
                 glm::vec3 position = {dist(mt), 0, dist(mt)-50.0f};
                 float base_image = float(rnd(mt)) * 3.0f;
                 auto entity = registry.create();
-                registry.assign<ecs::components::position>(entity, position);
+                registry.assign<ecs::components::position>(entity, position, position);
                 registry.assign<ecs::components::sprite>(entity, base_image);
-                registry.assign<ecs::components::bitmap_animation>(entity, base_image, 3.f, 0.2f, 0.f, 0);
+                registry.assign<ecs::components::bitmap_animation>(entity, base_image, 3.f, 0.2f, 0.f, 0.f);
                 registry.assign<ecs::components::physics_body>(entity);
             }
+            std::uniform_real_distribution<float> speed(-5.0f, 5.0f);
+            for (std::size_t i=0; i<settings.kinematic_entities; ++i) {
+                glm::vec3 position = {dist(mt), 10.0f, dist(mt)-50.0f};
+                float base_image = float(rnd(mt)) * 3.0f;
+                auto entity = registry.create();
+                registry.assign<ecs::components::position>(entity, position, position);
+                registry.assign<ecs::components::sprite>(entity, base_image);
+                registry.assign<ecs::components::bitmap_animation>(entity, base_image, 3.f, 0.2f, 0.f, 0.f);
+                registry.assign<ecs::components::kinematic_body>(entity, glm::vec3(speed(mt), speed(mt) + 5.0f, speed(mt)), 0.5f);
+            }
         }
 
         SDL_Event event;
-        bool running = true;
+        bool running = ! settings.headless;
 
         // Initialise timekeeping
         DeltaTime_t frame_time = 0;
@@ -323,6 +462,20 @@ int main (int argc, char* argv[])
         auto previous_time = start_time;
         auto current_time = start_time;
         long total_frames = 0;
+        // Simulation runs in fixed ticks, consuming the time accumulated by rendered frames
+        const DeltaTime_t tick_length = 1.0f / settings.tick_rate;
+        const ElapsedTime_t tick_length_micros = ElapsedTime_t(1000000.0f / settings.tick_rate);
+        DeltaTime_t tick_accumulator = 0;
+        ElapsedTime_t simulation_time = 0L; // microseconds
+        long total_ticks = 0;
+        auto tick = [&](){
+            trace_block("tick");
+            physicsEngine->stepSimulation(tick_length);
+            simulation_time += tick_length_micros;
+            sprite_animation_system->setTime(simulation_time);
+            simulation.run(registry);
+            ++total_ticks;
+        };
         bool buttons_dirty = false;
 
         Uint8 current_button_states[SDL_CONTROLLER_BUTTON_MAX] = {};
@@ -331,9 +484,24 @@ int main (int argc, char* argv[])
 
         graphics::camera& camera = services::locator::camera::ref();
 
-        info("Ready");
+        if (settings.headless) {
+            // Simulate as fast as possible until either limit is reached, there is no frame time to keep up with
+            info("Running headless simulation");
+            const auto budget = std::chrono::duration<float>(settings.duration);
+            auto headless_start = Clock::now();
+            while ((settings.ticks == 0 || std::size_t(total_ticks) < settings.ticks) &&
+                   (settings.duration <= 0.0f || Clock::now() - headless_start < budget)) {
+                tick();
+            }
+            auto elapsed = std::chrono::duration_cast<DeltaTime>(Clock::now() - headless_start).count();
+            info("Simulated {} ticks ({} seconds of game time) in {} seconds", total_ticks, float(total_ticks) * tick_length, elapsed);
+            info("Average tick time: {} ms", elapsed * 1000.0f / float(std::max(total_ticks, 1L)));
+            info("Ticks per second: {}", float(total_ticks) / elapsed);
+        } else {
+            info("Ready");
+        }
         // Run the main processing loop
-        do {
+        while (running) {
             trace_block("gameloop");
             camera.beginFrame(frame_time);
 
@@ -409,19 +577,28 @@ int main (int argc, char* argv[])
             if (current_button_states[SDL_CONTROLLER_BUTTON_RIGHTSHOULDER] && !prev_button_states[SDL_CONTROLLER_BUTTON_RIGHTSHOULDER]) {
                 info("Creating new physics enabled entity {} {}", current_button_states[SDL_CONTROLLER_BUTTON_RIGHTSHOULDER], prev_button_states[SDL_CONTROLLER_BUTTON_RIGHTSHOULDER]);
                 auto entity = registry.create();
-                registry.assign<ecs::components::position>(entity, glm::vec3(0, 0, 0));
+                registry.assign<ecs::components::position>(entity, glm::vec3(0, 0, 0), glm::vec3(0, 0, 0));
                 registry.assign<ecs::components::sprite>(entity, 0.f);
                 registry.assign<ecs::components::physics_body>(entity);
             }
 
-            physicsEngine->stepSimulation(frame_time);
-
-            sprite_animation_system->setTime(time_since_start);
-
-            for (auto system : systems) {
-                system->run(registry);
+            tick_accumulator += frame_time;
+            std::size_t ticks = 0;
+            while (tick_accumulator >= tick_length) {
+                if (ticks == settings.max_ticks_per_frame) {
+                    // Too far behind to catch up, drop the remaining time rather than spiralling further behind
+                    debug("Simulation fell behind, skipped {} ticks", std::size_t(tick_accumulator / tick_length));
+                    tick_accumulator = std::fmod(tick_accumulator, tick_length);
+                    break;
+                }
+                tick();
+                tick_accumulator -= tick_length;
+                ++ticks;
             }
 
+            sprite_render_system->setInterpolation(tick_accumulator / tick_length);
+            presentation.run(registry);
+
             renderer->render();
 
             SDL_GL_SwapWindow(window.get());
@@ -439,14 +616,19 @@ int main (int argc, char* argv[])
                 time_since_start += frame_time_micros;
             }
             ++total_frames;
-        } while (running);
-        
-        auto millis = float(time_since_start) * 0.001f;
-        auto seconds = millis * 0.001f;
-        info("Average frame time: {} ms", (millis / float(total_frames)));
-        info("Average framerate: {} FPS", total_frames / seconds);
+        }
+
+        if (total_frames > 0) {
+            auto millis = float(time_since_start) * 0.001f;
+            auto seconds = millis * 0.001f;
+            info("Average frame time: {} ms", (millis / float(total_frames)));
+            info("Average framerate: {} FPS", total_frames / seconds);
+            info("Average tick rate: {} Hz", total_ticks / seconds);
+        }
         // unloadLevel(level);
 
+        scheduler->term();
+
     } catch (std::exception& e) {
         error("Uncaught exception: {}", e.what());
         error("Terminating.");
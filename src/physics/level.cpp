@@ -0,0 +1,168 @@
+#include "physics/level.h"
+
+#include <cstring>
+
+#include <physfs.hpp>
+
+#include "util/helpers.h"
+#include "util/logging.h"
+#include "util/surfaces.h"
+
+namespace {
+
+// Written in front of the serialized BVH. The in-place format depends on the Bullet build, so that is checked too.
+struct CacheHeader {
+    char magic[4];
+    std::uint16_t version;
+    std::uint16_t scalar_size;
+    std::uint32_t bullet_version;
+    std::uint32_t triangles;
+    std::uint64_t source_hash;
+    std::uint64_t bvh_size;
+};
+constexpr char CacheMagic[4] = {'B', 'F', 'L', 'C'};
+// Bump whenever surfaces::forEachTile or TileTriangles change the triangles built from a level, so old caches are rebuilt
+constexpr std::uint16_t CacheVersion = 1;
+
+// FNV-1a, only used to tell whether the level file changed since the cache was written
+std::uint64_t hash (const std::string& data)
+{
+    std::uint64_t value = 14695981039346656037ull;
+    for (unsigned char c : data) {
+        value = (value ^ c) * 1099511628211ull;
+    }
+    return value;
+}
+
+btVector3 toBullet (const glm::vec3& v)
+{
+    return btVector3(v.x, v.y, v.z);
+}
+
+}
+
+physics::LevelCollision::LevelCollision ()
+    : bvh_buffer(nullptr)
+{
+
+}
+
+physics::LevelCollision::~LevelCollision ()
+{
+    unload();
+}
+
+void physics::LevelCollision::load (const std::string& config_file, const std::string& cache_file)
+{
+    unload();
+    const std::string source = helpers::readToString(config_file);
+    mesh = std::make_unique<btTriangleMesh>();
+    for (const auto& surface : surfaces::parse(source)) {
+        surfaces::forEachTile(surface, [this](std::int64_t, const std::array<glm::vec3, 4>& corners){
+            const auto& triangles = surfaces::TileTriangles;
+            for (std::size_t index = 0; index < triangles.size(); index += 3) {
+                mesh->addTriangle(toBullet(corners[triangles[index]]), toBullet(corners[triangles[index + 1]]), toBullet(corners[triangles[index + 2]]));
+            }
+        });
+    }
+    if (mesh->getNumTriangles() == 0) {
+        warn("Level {} has no surfaces, it will have no static collision", config_file);
+        mesh.reset();
+        return;
+    }
+
+    const auto source_hash = hash(source);
+    if (loadCache(cache_file, source_hash)) {
+        info("Loaded static collision for {} triangles from {}", mesh->getNumTriangles(), cache_file);
+    } else {
+        level_shape = std::make_unique<btBvhTriangleMeshShape>(mesh.get(), true, true);
+        info("Built static collision for {} triangles", mesh->getNumTriangles());
+        saveCache(cache_file, source_hash);
+    }
+}
+
+void physics::LevelCollision::unload ()
+{
+    level_shape.reset();
+    mesh.reset();
+    if (bvh_buffer) {
+        btAlignedFree(bvh_buffer);
+        bvh_buffer = nullptr;
+    }
+}
+
+bool physics::LevelCollision::loadCache (const std::string& cache_file, std::uint64_t source_hash)
+{
+    if (! PhysFS::exists(cache_file)) {
+        return false;
+    }
+    const std::string data = helpers::readToString(cache_file);
+    CacheHeader header;
+    if (data.size() < sizeof(header)) {
+        warn("Ignoring truncated collision cache {}", cache_file);
+        return false;
+    }
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (std::memcmp(header.magic, CacheMagic, sizeof(CacheMagic)) != 0
+        || header.version != CacheVersion
+        || header.bullet_version != std::uint32_t(btGetVersion())
+        || header.scalar_size != sizeof(btScalar)
+        || header.triangles != std::uint32_t(mesh->getNumTriangles())
+        || header.source_hash != source_hash
+        || header.bvh_size != data.size() - sizeof(header)) {
+        debug("Collision cache {} is out of date", cache_file);
+        return false;
+    }
+    // The BVH is deserialized in place, so it needs a buffer with the alignment it was serialized with
+    bvh_buffer = btAlignedAlloc(header.bvh_size, 16);
+    std::memcpy(bvh_buffer, data.data() + sizeof(header), header.bvh_size);
+    auto bvh = btOptimizedBvh::deSerializeInPlace(bvh_buffer, unsigned(header.bvh_size), false);
+    if (! bvh) {
+        warn("Could not read collision cache {}", cache_file);
+        btAlignedFree(bvh_buffer);
+        bvh_buffer = nullptr;
+        return false;
+    }
+    level_shape = std::make_unique<btBvhTriangleMeshShape>(mesh.get(), true, false);
+    level_shape->setOptimizedBvh(bvh);
+    return true;
+}
+
+void physics::LevelCollision::saveCache (const std::string& cache_file, std::uint64_t source_hash)
+{
+    if (! PHYSFS_getWriteDir()) {
+        debug("No write directory, not caching static collision");
+        return;
+    }
+    auto bvh = level_shape->getOptimizedBvh();
+    const unsigned bvh_size = bvh->calculateSerializeBufferSize();
+    std::string data(sizeof(CacheHeader) + bvh_size, '\0');
+    void* buffer = btAlignedAlloc(bvh_size, 16);
+    on_exit_scope([buffer](){ btAlignedFree(buffer); });
+    if (! bvh->serializeInPlace(buffer, bvh_size, false)) {
+        warn("Could not serialize static collision");
+        return;
+    }
+    CacheHeader header;
+    std::memcpy(header.magic, CacheMagic, sizeof(CacheMagic));
+    header.version = CacheVersion;
+    header.bullet_version = std::uint32_t(btGetVersion());
+    header.scalar_size = sizeof(btScalar);
+    header.triangles = std::uint32_t(mesh->getNumTriangles());
+    header.source_hash = source_hash;
+    header.bvh_size = bvh_size;
+    std::memcpy(&data[0], &header, sizeof(header));
+    std::memcpy(&data[sizeof(header)], buffer, bvh_size);
+
+    const auto separator = cache_file.find_last_of('/');
+    if (separator != std::string::npos) {
+        PHYSFS_mkdir(cache_file.substr(0, separator).c_str());
+    }
+    PhysFS::ofstream stream(cache_file);
+    stream.write(data.data(), std::streamsize(data.size()));
+    if (! stream) {
+        warn("Could not write collision cache {}", cache_file);
+        return;
+    }
+    info("Cached static collision in {}", cache_file);
+}
@@ -0,0 +1,194 @@
+#include "physics/memory.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+
+#include <LinearMath/btAlignedAllocator.h>
+
+#include "util/helpers.h"
+#include "util/logging.h"
+
+physics::Arena::Arena (std::size_t chunk_bytes)
+    : chunk_bytes(chunk_bytes)
+    , total_bytes(0)
+    , top(nullptr)
+    , end(nullptr)
+{
+
+}
+
+physics::Arena::~Arena ()
+{
+    deallocate();
+}
+
+void physics::Arena::allocate (std::size_t bytes)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    reserve(bytes);
+}
+
+void physics::Arena::deallocate ()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    for (auto chunk : chunks) {
+        std::free(chunk);
+    }
+    chunks.clear();
+    total_bytes = 0;
+    top = end = nullptr;
+}
+
+void* physics::Arena::request (std::size_t alignment, std::size_t size, std::size_t count)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    const std::size_t bytes = size * count;
+    char* buffer = top ? helpers::align(top, alignment) : nullptr;
+    if (! buffer || buffer + bytes > end) {
+        // Current chunk is exhausted, the remainder is abandoned
+        reserve(std::max(chunk_bytes, bytes + alignment));
+        buffer = helpers::align(top, alignment);
+    }
+    top = buffer + bytes;
+    return buffer;
+}
+
+void physics::Arena::release (void*)
+{
+    // Blocks are recycled by the pools, the arena only returns memory in deallocate()
+}
+
+void physics::Arena::reserve (std::size_t bytes)
+{
+    auto chunk = static_cast<char*>(std::malloc(bytes));
+    if (! chunk) {
+        fatal("Could not reserve {} KB for physics", bytes / 1024);
+    }
+    chunks.push_back(chunk);
+    total_bytes += bytes;
+    top = chunk;
+    end = chunk + bytes;
+    debug("Physics arena grew to {} KB", total_bytes / 1024);
+}
+
+physics::BlockPool::BlockPool (services::Resources::Allocator& allocator, std::size_t block_size, std::size_t alignment, std::size_t blocks_per_request)
+    : allocator(allocator)
+    , block_size(((std::max(block_size, sizeof(FreeBlock)) + alignment - 1) / alignment) * alignment)
+    , alignment(alignment)
+    , blocks_per_request(blocks_per_request)
+    , free_blocks(nullptr)
+    , live_blocks(0)
+{
+
+}
+
+void* physics::BlockPool::acquire ()
+{
+    if (! free_blocks) {
+        // Thread a fresh run of blocks onto the free list, last block first so that they are handed out in address order
+        auto blocks = static_cast<char*>(allocator.request(alignment, block_size, blocks_per_request));
+        for (std::size_t index = blocks_per_request; index > 0; --index) {
+            auto block = reinterpret_cast<FreeBlock*>(blocks + (index - 1) * block_size);
+            block->next = free_blocks;
+            free_blocks = block;
+        }
+    }
+    FreeBlock* block = free_blocks;
+    free_blocks = block->next;
+    ++live_blocks;
+    return block;
+}
+
+void physics::BlockPool::release (void* block)
+{
+    auto freed = static_cast<FreeBlock*>(block);
+    freed->next = free_blocks;
+    free_blocks = freed;
+    --live_blocks;
+}
+
+namespace {
+
+/**
+ * Bullet allocates through plain function pointers, so its pools live for the life of the program.
+ * Every allocation is prefixed with a header naming its size class, which keeps the 16 byte alignment Bullet expects.
+ */
+class BulletHeap {
+public:
+    static constexpr std::size_t HeaderSize = 16;
+    static constexpr std::uint32_t LargeAllocation = std::uint32_t(-1);
+    static constexpr std::size_t NumSizeClasses = 9; // 32 bytes to 8 KB
+
+    BulletHeap ()
+        : arena(4 * 1024 * 1024)
+        , pools{{
+            {arena, 32, 16, 1024}, {arena, 64, 16, 512}, {arena, 128, 16, 256},
+            {arena, 256, 16, 128}, {arena, 512, 16, 64}, {arena, 1024, 16, 32},
+            {arena, 2048, 16, 16}, {arena, 4096, 16, 8}, {arena, 8192, 16, 4},
+        }}
+    {}
+
+    void* allocate (std::size_t size) {
+        const std::size_t total = size + HeaderSize;
+        std::uint32_t size_class = 0;
+        while (size_class < NumSizeClasses && (std::size_t(32) << size_class) < total) {
+            ++size_class;
+        }
+        char* block;
+        if (size_class == NumSizeClasses) {
+            size_class = LargeAllocation;
+            block = static_cast<char*>(std::malloc(total));
+        } else {
+            // Bullet allocates from its worker threads when multithreaded
+            std::lock_guard<std::mutex> guard(locks[size_class]);
+            block = static_cast<char*>(pools[size_class].acquire());
+        }
+        *reinterpret_cast<std::uint32_t*>(block) = size_class;
+        return block + HeaderSize;
+    }
+
+    void free (void* pointer) {
+        if (! pointer) {
+            return;
+        }
+        char* block = static_cast<char*>(pointer) - HeaderSize;
+        const std::uint32_t size_class = *reinterpret_cast<std::uint32_t*>(block);
+        if (size_class == LargeAllocation) {
+            std::free(block);
+        } else {
+            std::lock_guard<std::mutex> guard(locks[size_class]);
+            pools[size_class].release(block);
+        }
+    }
+
+private:
+    physics::Arena arena;
+    std::array<physics::BlockPool, NumSizeClasses> pools;
+    std::array<std::mutex, NumSizeClasses> locks;
+};
+
+BulletHeap& bulletHeap ()
+{
+    static BulletHeap* heap = new BulletHeap(); // Never destroyed, Bullet may free memory during static destruction
+    return *heap;
+}
+
+void* bulletAllocate (std::size_t size)
+{
+    return bulletHeap().allocate(size);
+}
+
+void bulletFree (void* pointer)
+{
+    bulletHeap().free(pointer);
+}
+
+}
+
+void physics::installBulletAllocator ()
+{
+    bulletHeap();
+    btAlignedAllocSetCustom(bulletAllocate, bulletFree);
+}
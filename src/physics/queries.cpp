@@ -0,0 +1,237 @@
+#include "physics/engine.h"
+
+#include "services/locator.h"
+#include "util/logging.h"
+
+namespace {
+
+// Queries are cheap individually, so hand them to workers in batches
+constexpr std::size_t QueryGrainSize = 64;
+
+template <typename Fn>
+void forEachQuery (bool concurrent, std::size_t count, Fn&& fn)
+{
+    if (! concurrent || services::locator::scheduler::empty()) {
+        fn(std::size_t(0), count);
+    } else {
+        services::locator::scheduler::ref().parallelFor(count, QueryGrainSize, fn);
+    }
+}
+
+// Entity owning a collision object, false for the level's static geometry which has no motion state
+bool entityOf (const btCollisionObject* object, ecs::entity& entity)
+{
+    auto body = btRigidBody::upcast(object);
+    if (body && body->getMotionState()) {
+        entity = static_cast<const physics::EntityMotionState*>(body->getMotionState())->owner();
+        return true;
+    }
+    return false;
+}
+
+template <typename Fn>
+struct LeafCollector : btDbvt::ICollide {
+    Fn& fn;
+    explicit LeafCollector (Fn& fn) : fn(fn) {}
+    void Process (const btDbvtNode* leaf) override {
+        auto proxy = static_cast<btBroadphaseProxy*>(leaf->data);
+        fn(static_cast<btCollisionObject*>(proxy->m_clientObject));
+    }
+};
+
+template <typename Fn>
+struct RayCollector : btBroadphaseRayCallback {
+    Fn& fn;
+    RayCollector (Fn& fn, const btVector3& from, const btVector3& to) : fn(fn) {
+        // Used by broadphases that accelerate ray tests with a tree, set up the same way btCollisionWorld::rayTest does
+        btVector3 direction = to - from;
+        direction.normalize();
+        for (int axis = 0; axis < 3; ++axis) {
+            m_rayDirectionInverse[axis] = direction[axis] == btScalar(0) ? btScalar(BT_LARGE_FLOAT) : btScalar(1) / direction[axis];
+            m_signs[axis] = m_rayDirectionInverse[axis] < 0.0;
+        }
+        m_lambda_max = direction.dot(to - from);
+    }
+    bool process (const btBroadphaseProxy* proxy) override {
+        fn(static_cast<btCollisionObject*>(proxy->m_clientObject));
+        return true;
+    }
+};
+
+template <typename Fn>
+struct BoxCollector : btBroadphaseAabbCallback {
+    Fn& fn;
+    explicit BoxCollector (Fn& fn) : fn(fn) {}
+    bool process (const btBroadphaseProxy* proxy) override {
+        fn(static_cast<btCollisionObject*>(proxy->m_clientObject));
+        return true;
+    }
+};
+
+inline btVector3 toBullet (const glm::vec3& v)
+{
+    return btVector3(v.x, v.y, v.z);
+}
+
+inline glm::vec3 toGLM (const btVector3& v)
+{
+    return glm::vec3(v.x(), v.y(), v.z());
+}
+
+void addOverlap (services::Physics::Overlaps& result, ecs::entity entity)
+{
+    if (result.count < services::Physics::MaxOverlaps) {
+        result.entities[result.count] = entity;
+    }
+    ++result.count;
+}
+
+}
+
+// btDbvtBroadphase::rayTest() shares one traversal stack between all callers unless Bullet is built thread safe, so the
+// trees are walked directly instead, which only uses stacks local to the call. Other broadphases are searched through
+// their own interface and are not safe to search concurrently.
+template <typename Fn>
+void physics::Engine::forEachAlongRay (const btVector3& from, const btVector3& to, Fn&& fn) const
+{
+    if (broadphase_type == Broadphase::Dbvt) {
+        auto dbvt = static_cast<const btDbvtBroadphase*>(broadphase);
+        LeafCollector<Fn> collector(fn);
+        for (const auto& tree : dbvt->m_sets) {
+            btDbvt::rayTest(tree.m_root, from, to, collector);
+        }
+    } else {
+        RayCollector<Fn> collector(fn, from, to);
+        broadphase->rayTest(from, to, collector);
+    }
+}
+
+template <typename Fn>
+void physics::Engine::forEachInBox (const btVector3& min, const btVector3& max, Fn&& fn) const
+{
+    if (broadphase_type == Broadphase::Dbvt) {
+        auto dbvt = static_cast<const btDbvtBroadphase*>(broadphase);
+        LeafCollector<Fn> collector(fn);
+        const auto volume = btDbvtVolume::FromMM(min, max);
+        for (const auto& tree : dbvt->m_sets) {
+            tree.collideTV(tree.m_root, volume, collector);
+        }
+    } else {
+        BoxCollector<Fn> collector(fn);
+        broadphase->aabbTest(min, max, collector);
+    }
+}
+
+void physics::Engine::raycast (ecs::span<const Ray> rays, ecs::span<RayHit> hits)
+{
+    if (hits.size() < rays.size()) {
+        fatal("raycast called with {} rays but only {} results", rays.size(), hits.size());
+    }
+    forEachQuery(broadphase_type == Broadphase::Dbvt, rays.size(), [this, &rays, &hits](std::size_t begin, std::size_t end){
+        for (std::size_t index = begin; index < end; ++index) {
+            const auto from = toBullet(rays[index].from);
+            const auto to = toBullet(rays[index].to);
+            btTransform from_transform(btQuaternion::getIdentity(), from);
+            btTransform to_transform(btQuaternion::getIdentity(), to);
+            btCollisionWorld::ClosestRayResultCallback callback(from, to);
+            forEachAlongRay(from, to, [&](btCollisionObject* object){
+                btCollisionWorld::rayTestSingle(from_transform, to_transform, object, object->getCollisionShape(), object->getWorldTransform(), callback);
+            });
+            auto& hit = hits[index];
+            hit.hit = callback.hasHit();
+            hit.entity = entt::null;
+            if (hit.hit) {
+                entityOf(callback.m_collisionObject, hit.entity);
+                hit.position = toGLM(callback.m_hitPointWorld);
+                hit.normal = toGLM(callback.m_hitNormalWorld);
+                hit.fraction = callback.m_closestHitFraction;
+            } else {
+                hit.position = glm::vec3(0.0f);
+                hit.normal = glm::vec3(0.0f);
+                hit.fraction = 1.0f;
+            }
+        }
+    });
+}
+
+void physics::Engine::overlap (ecs::span<const Sphere> spheres, ecs::span<Overlaps> results)
+{
+    if (results.size() < spheres.size()) {
+        fatal("overlap called with {} spheres but only {} results", spheres.size(), results.size());
+    }
+    forEachQuery(broadphase_type == Broadphase::Dbvt, spheres.size(), [this, &spheres, &results](std::size_t begin, std::size_t end){
+        for (std::size_t index = begin; index < end; ++index) {
+            const auto center = toBullet(spheres[index].center);
+            const btScalar radius = spheres[index].radius;
+            const btVector3 extents(radius, radius, radius);
+            auto& result = results[index];
+            result.count = 0;
+            forEachInBox(center - extents, center + extents, [&](btCollisionObject* object){
+                ecs::entity entity;
+                if (! entityOf(object, entity)) {
+                    return;
+                }
+                // The broadphase only tested the sphere's bounding box, so check the distance to the body's box
+                btVector3 min, max;
+                object->getCollisionShape()->getAabb(object->getWorldTransform(), min, max);
+                btVector3 closest = center;
+                closest.setMax(min);
+                closest.setMin(max);
+                if (closest.distance2(center) <= radius * radius) {
+                    addOverlap(result, entity);
+                }
+            });
+        }
+    });
+}
+
+void physics::Engine::overlap (ecs::span<const Box> boxes, ecs::span<Overlaps> results)
+{
+    if (results.size() < boxes.size()) {
+        fatal("overlap called with {} boxes but only {} results", boxes.size(), results.size());
+    }
+    forEachQuery(broadphase_type == Broadphase::Dbvt, boxes.size(), [this, &boxes, &results](std::size_t begin, std::size_t end){
+        for (std::size_t index = begin; index < end; ++index) {
+            const auto center = toBullet(boxes[index].center);
+            const auto extents = toBullet(boxes[index].half_extents);
+            auto& result = results[index];
+            result.count = 0;
+            forEachInBox(center - extents, center + extents, [&](btCollisionObject* object){
+                ecs::entity entity;
+                if (entityOf(object, entity)) {
+                    addOverlap(result, entity);
+                }
+            });
+        }
+    });
+}
+
+void physics::Engine::nearest (ecs::span<const Sphere> spheres, ecs::span<Nearest> results)
+{
+    if (results.size() < spheres.size()) {
+        fatal("nearest called with {} spheres but only {} results", spheres.size(), results.size());
+    }
+    forEachQuery(broadphase_type == Broadphase::Dbvt, spheres.size(), [this, &spheres, &results](std::size_t begin, std::size_t end){
+        for (std::size_t index = begin; index < end; ++index) {
+            const auto center = toBullet(spheres[index].center);
+            const btScalar radius = spheres[index].radius;
+            const btVector3 extents(radius, radius, radius);
+            auto& result = results[index];
+            result.found = false;
+            btScalar closest = radius * radius;
+            forEachInBox(center - extents, center + extents, [&](btCollisionObject* object){
+                ecs::entity entity;
+                if (! entityOf(object, entity)) {
+                    return;
+                }
+                const btScalar distance = object->getWorldTransform().getOrigin().distance2(center);
+                if (distance <= closest) {
+                    closest = distance;
+                    result.entity = entity;
+                    result.found = true;
+                }
+            });
+            result.distance = result.found ? btSqrt(closest) : 0.0f;
+        }
+    });
+}
@@ -0,0 +1,64 @@
+#include "physics/task_scheduler.h"
+
+#ifdef BT_THREADSAFE
+
+#include <mutex>
+
+physics::TaskScheduler::TaskScheduler (jobs::Scheduler& scheduler, int num_threads)
+    : btITaskScheduler("jobs::Scheduler")
+    , scheduler(scheduler)
+    , num_threads(0)
+{
+    setNumThreads(num_threads);
+}
+
+int physics::TaskScheduler::getMaxNumThreads () const
+{
+    return int(scheduler.workers());
+}
+
+int physics::TaskScheduler::getNumThreads () const
+{
+    // Any worker may steal a range, and Bullet sizes its per-thread storage by this and indexes it with
+    // btGetCurrentThreadIndex(), so it has to cover all of them. num_threads only limits how many ranges a loop is split into.
+    return getMaxNumThreads();
+}
+
+void physics::TaskScheduler::setNumThreads (int threads)
+{
+    const int max_threads = getMaxNumThreads();
+    num_threads = (threads <= 0 || threads > max_threads) ? max_threads : threads;
+}
+
+std::size_t physics::TaskScheduler::grainFor (int count, int grain_size) const
+{
+    const std::size_t elements_per_range = (std::size_t(count) + num_threads - 1) / num_threads;
+    return std::max(std::size_t(std::max(grain_size, 1)), elements_per_range);
+}
+
+void physics::TaskScheduler::parallelFor (int begin, int end, int grain_size, const btIParallelForBody& body)
+{
+    if (end <= begin) {
+        return;
+    }
+    scheduler.parallelFor(std::size_t(end - begin), grainFor(end - begin, grain_size), [begin, &body](std::size_t first, std::size_t last){
+        body.forLoop(begin + int(first), begin + int(last));
+    });
+}
+
+btScalar physics::TaskScheduler::parallelSum (int begin, int end, int grain_size, const btIParallelSumBody& body)
+{
+    if (end <= begin) {
+        return btScalar(0);
+    }
+    std::mutex lock;
+    btScalar sum = btScalar(0);
+    scheduler.parallelFor(std::size_t(end - begin), grainFor(end - begin, grain_size), [begin, &body, &lock, &sum](std::size_t first, std::size_t last){
+        btScalar partial = body.sumLoop(begin + int(first), begin + int(last));
+        std::lock_guard<std::mutex> guard(lock);
+        sum += partial;
+    });
+    return sum;
+}
+
+#endif // BT_THREADSAFE
@@ -1,29 +1,150 @@
 #include "physics/engine.h"
 
+#include "util/logging.h"
+#include "services/locator.h"
+
+physics::Engine::Engine ()
+    : broadphase_type(Broadphase::Dbvt)
+    , world_size(0)
+    , fixed_time_step(1.0f / 60.0f)
+    , max_substeps(1)
+    , memory(1024 * 1024)
+    , body_pool(memory, 1024)
+    , motion_state_pool(memory, 1024)
+    , shape_pool(memory, 64)
+{
+
+}
+
 void physics::Engine::init ()
 {
+    installBulletAllocator();
+    setTimestep(services::locator::config<"physics.rate"_hs, float>(), services::locator::config<"physics.max-substeps"_hs, int>());
+    // 1 runs the world on the calling thread, anything else uses that many of the job scheduler's workers (0 for all)
+    const int threads = services::locator::config<"physics.threads"_hs, int>();
+    broadphase_type = Broadphase(services::locator::config<"physics.broadphase"_hs, int>());
+    world_size = services::locator::config<"physics.world-size"_hs, float>();
+    info("Using {} broadphase", broadphaseName(broadphase_type));
+#ifdef BT_THREADSAFE
+    if (threads != 1 && !services::locator::scheduler::empty()) {
+        task_scheduler = std::make_unique<TaskScheduler>(services::locator::scheduler::ref(), threads);
+        btSetTaskScheduler(task_scheduler.get());
+        info("Creating multithreaded physics world, splitting work into {} ranges across {} workers", task_scheduler->rangesPerLoop(), task_scheduler->getNumThreads());
+        btDefaultCollisionConstructionInfo construction_info;
+        // Pools are shared by all threads, so size them for larger scenes up front
+        construction_info.m_defaultMaxPersistentManifoldPoolSize = 80000;
+        construction_info.m_defaultMaxCollisionAlgorithmPoolSize = 80000;
+        collisionConfiguration = new btDefaultCollisionConfiguration(construction_info);
+        dispatcher = new btCollisionDispatcherMt(collisionConfiguration);
+        broadphase = createBroadphase();
+        solver_pool = new btConstraintSolverPoolMt(task_scheduler->getNumThreads());
+        solver = new btSequentialImpulseConstraintSolverMt();
+        dynamicsWorld = new btDiscreteDynamicsWorldMt(dispatcher, broadphase, solver_pool, solver, collisionConfiguration);
+        dynamicsWorld->setGravity(btVector3(0 , -10 , 0));
+        return;
+    }
+#else
+    if (threads != 1) {
+        warn("physics.threads is {}, but Bullet was built without BT_THREADSAFE. Running single threaded.", threads);
+    }
+#endif
     collisionConfiguration = new btDefaultCollisionConfiguration();
     dispatcher = new btCollisionDispatcher(collisionConfiguration);
-    broadphase = new btDbvtBroadphase();
+    broadphase = createBroadphase();
     solver = new btSequentialImpulseConstraintSolver();
     dynamicsWorld = new btDiscreteDynamicsWorld(dispatcher, broadphase, solver, collisionConfiguration);
     dynamicsWorld->setGravity(btVector3(0 , -10 , 0));
 }
 
+btBroadphaseInterface* physics::Engine::createBroadphase ()
+{
+    if (broadphase_type == Broadphase::Dbvt) {
+        return new btDbvtBroadphase();
+    }
+    if (world_size <= 0.0f) {
+        fatal("physics.world_size must be greater than zero for the {} broadphase", broadphaseName(broadphase_type));
+    }
+    const btVector3 world_max(world_size, world_size, world_size);
+    if (broadphase_type == Broadphase::AxisSweep) {
+        return new btAxisSweep3(-world_max, world_max);
+    }
+    return new bt32BitAxisSweep3(-world_max, world_max);
+}
+
 void physics::Engine::term ()
 {
+    if (level_body) {
+        dynamicsWorld->removeRigidBody(level_body);
+        delete level_body;
+        level_body = nullptr;
+    }
+    level.unload();
+    for (auto physics_body : bodies) {
+        dynamicsWorld->removeRigidBody(physics_body);
+        destroyBody(physics_body);
+    }
+    body_slots.clear();
+    body_entities.clear();
+    bodies.clear();
+    for (auto& [key, cached] : shape_cache) {
+        shape_pool.destroy(static_cast<btBoxShape*>(cached.shape));
+    }
+    shape_cache.clear();
     delete dynamicsWorld;
     delete solver;
+#ifdef BT_THREADSAFE
+    if (task_scheduler) {
+        delete solver_pool;
+        solver_pool = nullptr;
+        btSetTaskScheduler(nullptr);
+        task_scheduler.reset();
+    }
+#endif
     delete broadphase;
     delete dispatcher;
     delete collisionConfiguration;
 }
 
-void physics::Engine::addBody (const ecs::entity entity, const Body& body, const Shape& shape)
+void physics::Engine::loadLevel (const std::string& config_file)
 {
-        btCollisionShape* body_shape = new btBoxShape(btVector3(btScalar(shape.halfExtents.x), btScalar(shape.halfExtents.y), btScalar(shape.halfExtents.z)));
+    if (level_body) {
+        dynamicsWorld->removeRigidBody(level_body);
+        delete level_body;
+        level_body = nullptr;
+    }
+    // maps/level.toml is cached as cache/maps/level.bvh
+    auto cache_file = "cache/" + config_file.substr(0, config_file.find_last_of('.')) + ".bvh";
+    level.load(config_file, cache_file);
+    if (auto shape = level.shape()) {
+        // Static, so it needs neither mass nor a motion state
+        btRigidBody::btRigidBodyConstructionInfo level_info(0, nullptr, shape);
+        level_body = new btRigidBody(level_info);
+        dynamicsWorld->addRigidBody(level_body);
+    }
+}
+
+void physics::Engine::setTimestep (float rate, int max_substeps)
+{
+    if (rate <= 0.0f || max_substeps < 1) {
+        fatal("Invalid physics timestep: rate {} with at most {} substeps", rate, max_substeps);
+    }
+    fixed_time_step = 1.0f / rate;
+    this->max_substeps = max_substeps;
+    info("Physics steps at {} Hz, at most {} steps per update", rate, max_substeps);
+}
+
+void physics::Engine::stepSimulation (float delta_time)
+{
+    moved.reset(bodies.size());
+    const int steps = dynamicsWorld->stepSimulation(delta_time, max_substeps, fixed_time_step);
+    if (steps > max_substeps) {
+        debug("Physics fell behind, dropped {} steps", steps - max_substeps);
+    }
+}
 
-        collisionShapes.push_back(body_shape);
+void physics::Engine::addBody (const ecs::entity entity, const Body& body, const Shape& shape)
+{
+        btCollisionShape* body_shape = acquireShape(shape);
 
         btTransform transform;
         transform.setIdentity();
@@ -40,49 +161,170 @@ void physics::Engine::addBody (const ecs::entity entity, const Body& body, const
         }
 
         //using motionstate is optional, it provides interpolation capabilities, and only synchronizes 'active' objects
-        btDefaultMotionState* motion_state = new btDefaultMotionState(transform);
+        EntityMotionState* motion_state = motion_state_pool.create(moved, entity, transform);
         btRigidBody::btRigidBodyConstructionInfo rigitbody_info(mass, motion_state, body_shape, local_inertia);
         rigitbody_info.m_restitution = body.restitution;
         rigitbody_info.m_friction = body.friction;
-        btRigidBody* rigid_body = new btRigidBody(rigitbody_info);
-        rigid_body->setLinearVelocity(btVector3(0, 0, -5.0f));
+        btRigidBody* rigid_body = body_pool.create(rigitbody_info);
+        if (isDynamic) {
+            rigid_body->setLinearVelocity(btVector3(0, 0, -5.0f));
+        }
 
         //add the body to the dynamics world
         dynamicsWorld->addRigidBody(rigid_body);
-        physics_bodies[entity] = rigid_body;
+        insertBody(entity, rigid_body);
 }
 
 void physics::Engine::addBodies (const std::vector<ecs::entity>& entities, const std::vector<Body>& bodies, const std::vector<Shape>& shapes)
 {
-
+    if (bodies.size() != entities.size() || shapes.size() != entities.size()) {
+        fatal("addBodies called with {} entities, {} bodies and {} shapes", entities.size(), bodies.size(), shapes.size());
+    }
+    // Grow the body table once for the whole batch
+    body_entities.reserve(body_entities.size() + entities.size());
+    this->bodies.reserve(this->bodies.size() + entities.size());
+    for (std::size_t index = 0; index < entities.size(); ++index) {
+        Engine::addBody(entities[index], bodies[index], shapes[index]);
+    }
 }
 
 void physics::Engine::getBodyPosition (const ecs::entity entity, glm::vec3& position)
 {
-    auto it = physics_bodies.find(entity);
-    if (it != physics_bodies.end()) {
-        auto [key, physics_body] = *it;
-        const auto& transform = physics_body->getWorldTransform();
-        auto origin = transform.getOrigin();
+    if (auto physics_body = findBody(entity)) {
+        auto origin = interpolatedTransform(physics_body).getOrigin();
         position = glm::vec3(origin.x(), origin.y(), origin.z());
     }
 }
 
-void physics::Engine::getBodyPositions (const std::vector<ecs::entity> entities, std::vector<glm::vec3>& positions)
+void physics::Engine::getBodyPositions (ecs::span<const ecs::entity> entities, glm::vec3* positions, std::size_t stride)
 {
+    auto output = reinterpret_cast<char*>(positions);
+    for (auto entity : entities) {
+        if (auto physics_body = findBody(entity)) {
+            const auto& origin = interpolatedTransform(physics_body).getOrigin();
+            *reinterpret_cast<glm::vec3*>(output) = glm::vec3(origin.x(), origin.y(), origin.z());
+        }
+        output += stride;
+    }
+}
 
+physics::Engine::Moved physics::Engine::movedBodies () const
+{
+    const std::size_t count = moved.count.load(std::memory_order_acquire);
+    return {ecs::span<const ecs::entity>(moved.entities.data(), count), ecs::span<const glm::vec3>(moved.positions.data(), count)};
 }
 
 void physics::Engine::removeBody (const ecs::entity entity)
 {
-    auto it = physics_bodies.find(entity);
-    if (it != physics_bodies.end()) {
-        dynamicsWorld->removeRigidBody(it->second);
-        physics_bodies.erase(it);
+    if (auto physics_body = eraseBody(entity)) {
+        dynamicsWorld->removeRigidBody(physics_body);
+        destroyBody(physics_body);
     }
 }
 
 void physics::Engine::removeBodies (const std::vector<ecs::entity>& entities)
 {
+    for (auto entity : entities) {
+        if (auto physics_body = eraseBody(entity)) {
+            dynamicsWorld->removeRigidBody(physics_body);
+            destroyBody(physics_body);
+        }
+    }
+}
+
+btCollisionShape* physics::Engine::acquireShape (const Shape& shape)
+{
+    ShapeKey key{shape.halfExtents.x, shape.halfExtents.y, shape.halfExtents.z};
+    auto it = shape_cache.find(key);
+    if (it == shape_cache.end()) {
+        auto box = shape_pool.create(btVector3(btScalar(shape.halfExtents.x), btScalar(shape.halfExtents.y), btScalar(shape.halfExtents.z)));
+        it = shape_cache.emplace(key, CachedShape{box, 0, key}).first;
+        // Map nodes never move, so the shape can point back at its cache entry
+        box->setUserPointer(&it->second);
+    }
+    ++it->second.references;
+    return it->second.shape;
+}
+
+void physics::Engine::releaseShape (btCollisionShape* shape)
+{
+    auto cached = static_cast<CachedShape*>(shape->getUserPointer());
+    if (--cached->references == 0) {
+        ShapeKey key = cached->key;
+        shape_cache.erase(key);
+        shape_pool.destroy(static_cast<btBoxShape*>(shape));
+    }
+}
+
+void physics::Engine::destroyBody (btRigidBody* body)
+{
+    releaseShape(body->getCollisionShape());
+    motion_state_pool.destroy(static_cast<EntityMotionState*>(body->getMotionState()));
+    body_pool.destroy(body);
+}
 
+void physics::Engine::insertBody (const ecs::entity entity, btRigidBody* body)
+{
+    auto index = ecs::entity_index(entity);
+    if (index >= body_slots.size()) {
+        body_slots.resize(index + 1, NoBody);
+    }
+    auto slot = body_slots[index];
+    if (slot != NoBody) {
+        // The index is being reused before the body it held was removed, don't leak the old body
+        dynamicsWorld->removeRigidBody(bodies[slot]);
+        destroyBody(bodies[slot]);
+        body_entities[slot] = entity;
+        bodies[slot] = body;
+        return;
+    }
+    body_slots[index] = std::uint32_t(bodies.size());
+    body_entities.push_back(entity);
+    bodies.push_back(body);
+}
+
+btRigidBody* physics::Engine::eraseBody (const ecs::entity entity)
+{
+    auto index = ecs::entity_index(entity);
+    if (index >= body_slots.size()) {
+        return nullptr;
+    }
+    auto slot = body_slots[index];
+    if (slot == NoBody || body_entities[slot] != entity) {
+        return nullptr;
+    }
+    btRigidBody* body = bodies[slot];
+    // Move the last body into the freed slot to keep the arrays dense
+    auto last = bodies.size() - 1;
+    if (slot != last) {
+        body_entities[slot] = body_entities[last];
+        bodies[slot] = bodies[last];
+        body_slots[ecs::entity_index(body_entities[slot])] = slot;
+    }
+    body_entities.pop_back();
+    bodies.pop_back();
+    body_slots[index] = NoBody;
+    return body;
+}
+
+physics::Broadphase physics::broadphaseFromName (const std::string& name)
+{
+    if (name == "dbvt") {
+        return Broadphase::Dbvt;
+    } else if (name == "axis-sweep") {
+        return Broadphase::AxisSweep;
+    } else if (name == "axis-sweep-32") {
+        return Broadphase::AxisSweep32;
+    }
+    fatal("Unknown broadphase '{}', expected dbvt, axis-sweep or axis-sweep-32", name);
+}
+
+const char* physics::broadphaseName (Broadphase broadphase)
+{
+    switch (broadphase) {
+        case Broadphase::Dbvt: return "dbvt";
+        case Broadphase::AxisSweep: return "axis-sweep";
+        case Broadphase::AxisSweep32: return "axis-sweep-32";
+    }
+    return "unknown";
 }
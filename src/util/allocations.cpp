@@ -0,0 +1,77 @@
+#include "util/allocations.h"
+
+#ifdef DEBUG_BUILD
+
+#include <cstdlib>
+#include <new>
+
+namespace {
+    thread_local std::size_t thread_allocations = 0;
+
+    void* allocate (std::size_t size)
+    {
+        ++thread_allocations;
+        if (void* pointer = std::malloc(size ? size : 1)) {
+            return pointer;
+        }
+        throw std::bad_alloc();
+    }
+
+    void* allocateAligned (std::size_t size, std::align_val_t alignment)
+    {
+        ++thread_allocations;
+        void* pointer = nullptr;
+#if defined(_MSC_VER)
+        pointer = _aligned_malloc(size ? size : 1, static_cast<std::size_t>(alignment));
+#else
+        if (posix_memalign(&pointer, static_cast<std::size_t>(alignment), size ? size : 1) != 0) {
+            pointer = nullptr;
+        }
+#endif
+        if (pointer) {
+            return pointer;
+        }
+        throw std::bad_alloc();
+    }
+
+    void deallocateAligned (void* pointer)
+    {
+#if defined(_MSC_VER)
+        _aligned_free(pointer);
+#else
+        std::free(pointer);
+#endif
+    }
+}
+
+std::size_t allocations::threadCount ()
+{
+    return thread_allocations;
+}
+
+// Replacements for the global allocation functions, so that every allocation made through new is counted
+
+void* operator new (std::size_t size) { return allocate(size); }
+void* operator new[] (std::size_t size) { return allocate(size); }
+void* operator new (std::size_t size, const std::nothrow_t&) noexcept { try { return allocate(size); } catch (...) { return nullptr; } }
+void* operator new[] (std::size_t size, const std::nothrow_t&) noexcept { try { return allocate(size); } catch (...) { return nullptr; } }
+void* operator new (std::size_t size, std::align_val_t alignment) { return allocateAligned(size, alignment); }
+void* operator new[] (std::size_t size, std::align_val_t alignment) { return allocateAligned(size, alignment); }
+
+void operator delete (void* pointer) noexcept { std::free(pointer); }
+void operator delete[] (void* pointer) noexcept { std::free(pointer); }
+void operator delete (void* pointer, std::size_t) noexcept { std::free(pointer); }
+void operator delete[] (void* pointer, std::size_t) noexcept { std::free(pointer); }
+void operator delete (void* pointer, std::align_val_t) noexcept { deallocateAligned(pointer); }
+void operator delete[] (void* pointer, std::align_val_t) noexcept { deallocateAligned(pointer); }
+void operator delete (void* pointer, std::size_t, std::align_val_t) noexcept { deallocateAligned(pointer); }
+void operator delete[] (void* pointer, std::size_t, std::align_val_t) noexcept { deallocateAligned(pointer); }
+
+#else
+
+std::size_t allocations::threadCount ()
+{
+    return 0;
+}
+
+#endif
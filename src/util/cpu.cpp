@@ -0,0 +1,41 @@
+#include "util/cpu.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+bool cpu::hasSSE41 ()
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 19)) != 0;
+#else
+    return __builtin_cpu_supports("sse4.1");
+#endif
+}
+
+bool cpu::hasAVX2 ()
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    bool os_saves_ymm = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+    __cpuidex(info, 7, 0);
+    return os_saves_ymm && (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+bool cpu::hasF16C ()
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    bool os_saves_ymm = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+    return os_saves_ymm && (info[2] & (1 << 29)) != 0;
+#else
+    return __builtin_cpu_supports("f16c");
+#endif
+}
@@ -5,6 +5,11 @@
 #include "util/logging.h"
 
 #include <exception>
+#include <cstdlib>
+
+#ifdef __GNUG__
+#include <cxxabi.h>
+#endif
 
 std::string helpers::readToString(const std::string& filename)
 {
@@ -16,4 +21,18 @@ std::string helpers::readToString(const std::string& filename)
         auto message = std::string{"File could not be read: "} + filename;
         throw std::invalid_argument(message);
     }
-}
\ No newline at end of file
+}
+
+std::string helpers::demangle(const char* name)
+{
+#ifdef __GNUG__
+    int status = 0;
+    char* demangled = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+    if (status == 0) {
+        std::string result{demangled};
+        std::free(demangled);
+        return result;
+    }
+#endif
+    return std::string{name};
+}
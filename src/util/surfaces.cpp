@@ -0,0 +1,43 @@
+#include "util/surfaces.h"
+
+#include <sstream>
+
+#include <cpptoml.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "util/logging.h"
+
+std::vector<surfaces::Surface> surfaces::parse (const std::string& source)
+{
+    std::vector<Surface> result;
+    try {
+        std::istringstream iss;
+        iss.str(source);
+        cpptoml::parser parser{iss};
+        std::shared_ptr<cpptoml::table> config = parser.parse();
+        auto tarr = config->get_table_array("surface");
+        for (const auto& table : *tarr) {
+            auto position = table->get_array_of<double>("position");
+            auto rotate = table->get_array_of<double>("rotate");
+            auto imageset_name = table->get_as<std::string>("imageset");
+            auto tile_data = table->get_array_of<cpptoml::array>("tiles");
+
+            auto pos = glm::vec3((*position)[0], (*position)[1], (*position)[2]);
+            glm::mat4 matrix = glm::mat4(1);
+            matrix = glm::translate(matrix, pos);
+            matrix = glm::rotate(matrix, glm::radians(float((*rotate)[0])), glm::vec3(1, 0, 0));
+            matrix = glm::rotate(matrix, glm::radians(float((*rotate)[1])), glm::vec3(0, 1, 0));
+            matrix = glm::rotate(matrix, glm::radians(float((*rotate)[2])), glm::vec3(0, 0, 1));
+
+            Surface surface{*imageset_name, matrix, {}};
+            for (const auto& row_data : *tile_data) {
+                surface.tiles.push_back(*row_data->get_array_of<int64_t>());
+            }
+            result.push_back(std::move(surface));
+        }
+    }
+    catch (const cpptoml::parse_exception& e) {
+        fatal("Parsing failed: {}", e.what());
+    }
+    return result;
+}
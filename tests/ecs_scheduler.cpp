@@ -0,0 +1,215 @@
+#include "catch.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "ecs/scheduler.h"
+#include "ecs/system.h"
+
+namespace {
+
+struct a { float value; };
+struct b { float value; };
+struct c { float value; };
+struct d { float value; };
+struct some_service {};
+
+// When each system started and finished during a frame, on one clock shared by all systems
+struct timeline {
+    std::atomic<std::size_t> clock{0};
+    std::vector<std::size_t> started;
+    std::vector<std::size_t> finished;
+
+    explicit timeline (std::size_t systems) : started(systems), finished(systems) {}
+};
+
+// Systems that meet at the rendezvous wait there for each other, so they only all arrive if they run at the same time
+struct rendezvous {
+    std::atomic<std::size_t> arrived{0};
+    std::size_t expected = 0;
+
+    // Whether everybody arrived before the timeout
+    bool meet () {
+        arrived.fetch_add(1);
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+        while (arrived.load() < expected) {
+            if (std::chrono::steady_clock::now() > deadline) {
+                return false;
+            }
+            std::this_thread::yield();
+        }
+        return true;
+    }
+};
+
+// Records its start and finish in pre() and post(), and optionally meets the others at a rendezvous in between
+template <class This, typename... Components>
+class timed_system : public ecs::base_system<This, Components...> {
+public:
+    std::size_t slot = 0;
+    timeline* times = nullptr;
+    rendezvous* meeting = nullptr;
+    bool met = false;
+
+    void pre () {
+        times->started[slot] = times->clock.fetch_add(1);
+        if (meeting) {
+            met = meeting->meet();
+        }
+    }
+    void post () {
+        times->finished[slot] = times->clock.fetch_add(1);
+    }
+};
+
+class writes_a : public timed_system<writes_a, a> {
+public:
+    void update (ecs::entity, a& value) { value.value += 1.0f; }
+};
+
+class reads_a : public timed_system<reads_a, a> {
+public:
+    void update (ecs::entity, const a&) {}
+};
+
+class reads_a_writes_b : public timed_system<reads_a_writes_b, a, b> {
+public:
+    void update (ecs::entity, const a&, b& value) { value.value += 1.0f; }
+};
+
+class writes_b : public timed_system<writes_b, b> {
+public:
+    void update (ecs::entity, b& value) { value.value += 1.0f; }
+};
+
+class writes_c : public timed_system<writes_c, c> {
+public:
+    void update (ecs::entity, c& value) { value.value += 1.0f; }
+};
+
+// Only iterates d, but declares that it also writes a and a service, as if it did so in pre() or notify()
+class writes_d_declares_a : public timed_system<writes_d_declares_a, d> {
+public:
+    using writes = ecs::type_list<a, some_service>;
+    void update (ecs::entity, d& value) { value.value += 1.0f; }
+};
+
+class declares_service : public timed_system<declares_service, c> {
+public:
+    using writes = ecs::type_list<some_service>;
+    void update (ecs::entity, const c&) {}
+};
+
+struct scheduler_fixture {
+    scheduler_fixture () {
+        auto scheduler = std::make_shared<jobs::Scheduler>();
+        scheduler->init(4);
+        services::locator::scheduler::set(scheduler);
+        for (int index = 0; index < 100; ++index) {
+            auto entity = registry.create();
+            registry.assign<a>(entity, 0.0f);
+            registry.assign<b>(entity, 0.0f);
+            registry.assign<c>(entity, 0.0f);
+            registry.assign<d>(entity, 0.0f);
+        }
+    }
+    ~scheduler_fixture () {
+        services::locator::scheduler::ref().term();
+        services::locator::scheduler::reset();
+    }
+
+    template <typename System>
+    void add (System& system) {
+        system.slot = systems++;
+        system.times = &times;
+        schedule.add(&system);
+    }
+
+    ecs::registry_type registry;
+    ecs::scheduler schedule;
+    timeline times{16};
+    std::size_t systems = 0;
+};
+
+constexpr int Frames = 50;
+
+}
+
+TEST_CASE_METHOD(scheduler_fixture, "Conflicting systems run in the order they were added", "[ecs][scheduler]")
+{
+    // Like position_snapshot, physics_simulation and kinematic_integration in main: each one conflicts with the one before
+    writes_a first; // Writes a
+    reads_a_writes_b second; // Reads what first wrote
+    writes_d_declares_a third; // Only iterates d, but declares writing a, which second reads
+    writes_b fourth; // Writes b, which second also writes
+    add(first);
+    add(second);
+    add(third);
+    add(fourth);
+    const std::pair<std::size_t, std::size_t> ordered[] = {{0, 1}, {1, 2}, {0, 2}, {1, 3}};
+    for (int frame = 0; frame < Frames; ++frame) {
+        schedule.run(registry);
+        for (const auto& [earlier, later] : ordered) {
+            INFO("frame " << frame << ", system " << earlier << " before system " << later << "\n" << schedule.dump());
+            REQUIRE(times.finished[earlier] < times.started[later]);
+        }
+    }
+}
+
+TEST_CASE_METHOD(scheduler_fixture, "Systems that don't conflict can run at the same time", "[ecs][scheduler]")
+{
+    rendezvous meeting;
+    auto join = [&](auto& system) {
+        system.meeting = &meeting;
+        ++meeting.expected;
+        add(system);
+    };
+
+    SECTION("when they only read the same component") {
+        reads_a first;
+        reads_a_writes_b second;
+        join(first);
+        join(second);
+        schedule.run(registry);
+        REQUIRE(first.met);
+        REQUIRE(second.met);
+    }
+
+    SECTION("when they write different components") {
+        writes_a first;
+        writes_b second;
+        writes_c third;
+        join(first);
+        join(second);
+        join(third);
+        schedule.run(registry);
+        REQUIRE(first.met);
+        REQUIRE(second.met);
+        REQUIRE(third.met);
+    }
+}
+
+TEST_CASE_METHOD(scheduler_fixture, "Declared writes order systems like component writes do", "[ecs][scheduler]")
+{
+    writes_d_declares_a first;
+    declares_service second; // Conflicts with first only through the service both declare
+    writes_c third; // Conflicts with second through c, but not with first
+    add(first);
+    add(second);
+    add(third);
+    for (int frame = 0; frame < Frames; ++frame) {
+        schedule.run(registry);
+        INFO("frame " << frame << "\n" << schedule.dump());
+        REQUIRE(times.finished[0] < times.started[1]);
+        REQUIRE(times.finished[1] < times.started[2]);
+    }
+    // first and third are only ordered through second, they don't depend on each other directly
+    const auto dump = schedule.dump();
+    INFO(dump);
+    REQUIRE(dump.find("after [0] " + first.name() + ": both write") != std::string::npos);
+    REQUIRE(dump.find("after [1] " + second.name() + ": reads") != std::string::npos);
+    REQUIRE(dump.find("after [0]", dump.find("[2] ")) == std::string::npos);
+}
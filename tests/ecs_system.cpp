@@ -0,0 +1,88 @@
+#include "catch.hpp"
+
+#include <vector>
+
+#include "ecs/system.h"
+#include "util/allocations.h"
+
+namespace {
+
+struct tracked {
+    float value;
+};
+
+class tracking_system : public ecs::base_system<tracking_system, tracked> {
+public:
+    std::size_t live = 0;
+
+    void update (ecs::entity, tracked& t) {
+        t.value += 1.0f;
+    }
+
+    void notify (ecs::registry_type&, ecs::EntityNotification notification, const std::vector<ecs::entity>& entities) {
+        if (notification == ecs::EntityNotification::ADDED) {
+            live += entities.size();
+        } else {
+            live -= entities.size();
+        }
+    }
+};
+
+// Heap allocations made by the calling thread while running the system, registry changes made beforehand don't count
+std::size_t allocationsDuringRun (tracking_system& system, ecs::registry_type& registry)
+{
+    const std::size_t start = allocations::threadCount();
+    system.run(registry);
+    return allocations::threadCount() - start;
+}
+
+}
+
+TEST_CASE("Systems don't allocate once warmed up", "[ecs][allocations]")
+{
+    constexpr std::size_t population = 10000;
+    constexpr std::size_t churn = 10;
+    constexpr std::size_t warmup_frames = 5;
+    constexpr std::size_t frames = 100;
+
+    ecs::registry_type registry;
+    std::vector<ecs::entity> entities;
+    for (std::size_t i = 0; i < population; ++i) {
+        auto entity = registry.create();
+        registry.assign<tracked>(entity, 0.0f);
+        entities.push_back(entity);
+    }
+    tracking_system system;
+    const std::size_t reported_before = ecs::steady_state_allocations();
+
+    SECTION("with a stable population") {
+        for (std::size_t frame = 0; frame < warmup_frames; ++frame) {
+            system.run(registry);
+        }
+        REQUIRE(system.live == population);
+        for (std::size_t frame = 0; frame < frames; ++frame) {
+            REQUIRE(allocationsDuringRun(system, registry) == 0);
+        }
+        REQUIRE(ecs::steady_state_allocations() == reported_before);
+    }
+
+    SECTION("with entities added and removed every frame") {
+        auto replace = [&](std::size_t frame) {
+            for (std::size_t i = 0; i < churn; ++i) {
+                auto& entity = entities[(frame * churn + i) % population];
+                registry.destroy(entity);
+                entity = registry.create();
+                registry.assign<tracked>(entity, 0.0f);
+            }
+        };
+        for (std::size_t frame = 0; frame < warmup_frames; ++frame) {
+            replace(frame);
+            system.run(registry);
+        }
+        for (std::size_t frame = warmup_frames; frame < warmup_frames + frames; ++frame) {
+            replace(frame);
+            REQUIRE(allocationsDuringRun(system, registry) == 0);
+        }
+        REQUIRE(system.live == population);
+    }
+}
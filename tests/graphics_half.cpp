@@ -0,0 +1,100 @@
+#include "catch.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+#include "graphics/half.h"
+#include "util/cpu.h"
+
+// Defined in half_f16c.cpp, the only file built with F16C enabled
+std::uint16_t referenceHalf (float value);
+
+namespace {
+
+float fromBits (std::uint32_t bits)
+{
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+bool isNaN (std::uint16_t half)
+{
+    return (half & 0x7c00u) == 0x7c00u && (half & 0x03ffu) != 0;
+}
+
+// NaN payloads are not carried over, so any two NaNs of the same sign are equal
+bool sameHalf (std::uint16_t a, std::uint16_t b)
+{
+    return a == b || (isNaN(a) && isNaN(b) && (a & 0x8000u) == (b & 0x8000u));
+}
+
+}
+
+TEST_CASE("toHalf converts edge values", "[graphics][half]")
+{
+    REQUIRE(graphics::toHalf(0.0f) == 0x0000);
+    REQUIRE(graphics::toHalf(-0.0f) == 0x8000);
+    REQUIRE(graphics::toHalf(1.0f) == 0x3c00);
+    REQUIRE(graphics::toHalf(-2.0f) == 0xc000);
+    REQUIRE(graphics::toHalf(65504.0f) == 0x7bff); // Largest half
+    REQUIRE(graphics::toHalf(65519.0f) == 0x7bff); // Just below the tie with infinity
+    REQUIRE(graphics::toHalf(65520.0f) == 0x7c00); // Tie, rounds to even, which is infinity
+    REQUIRE(graphics::toHalf(std::numeric_limits<float>::infinity()) == 0x7c00);
+    REQUIRE(graphics::toHalf(-std::numeric_limits<float>::infinity()) == 0xfc00);
+    REQUIRE(isNaN(graphics::toHalf(std::numeric_limits<float>::quiet_NaN())));
+    REQUIRE(isNaN(graphics::toHalf(fromBits(0x7f800001u)))); // Payload only in bits a half drops
+    REQUIRE((graphics::toHalf(fromBits(0xffc00000u)) & 0x8000) != 0); // NaNs keep their sign
+    // Ties between two halves round to the even one
+    REQUIRE(graphics::toHalf(1.0f + 1.0f / 2048.0f) == 0x3c00);
+    REQUIRE(graphics::toHalf(1.0f + 3.0f / 2048.0f) == 0x3c02);
+    // Half subnormals, down to the smallest one and the tie below it
+    REQUIRE(graphics::toHalf(fromBits(0x38800000u)) == 0x0400); // Smallest normal half
+    REQUIRE(graphics::toHalf(fromBits(0x33800000u)) == 0x0001); // 2^-24, smallest subnormal half
+    REQUIRE(graphics::toHalf(fromBits(0x33000000u)) == 0x0000); // 2^-25, tie with zero
+    REQUIRE(graphics::toHalf(fromBits(0x33000001u)) == 0x0001);
+    REQUIRE(graphics::toHalf(fromBits(0x33c00000u)) == 0x0002); // 1.5 * 2^-24, tie rounds to even
+    // Float subnormals are far below the smallest half
+    REQUIRE(graphics::toHalf(fromBits(0x00000001u)) == 0x0000);
+    REQUIRE(graphics::toHalf(fromBits(0x807fffffu)) == 0x8000);
+}
+
+TEST_CASE("toHalf matches F16C", "[graphics][half]")
+{
+    if (! cpu::hasF16C()) {
+        WARN("F16C is not supported by this CPU, nothing to compare against");
+        return;
+    }
+
+    SECTION("on edge values") {
+        const std::uint32_t edges[] = {
+            0x00000000u, 0x00000001u, 0x007fffffu, 0x00800000u, // Float zero, subnormals and smallest normal
+            0x33000000u, 0x33000001u, 0x337fffffu, 0x33800000u, 0x33c00000u, 0x38000000u, 0x387fc000u, 0x387fe000u, 0x387fffffu, // Half subnormals and ties
+            0x38800000u, 0x3f800000u, 0x3f801000u, 0x3f803000u, 0x3f800fffu, 0x3f801001u, // Normals and ties
+            0x477fe000u, 0x477fefffu, 0x477ff000u, 0x477fffffu, 0x47800000u, 0x7f7fffffu, // Around the largest half
+            0x7f800000u, 0x7f800001u, 0x7fc00000u, 0x7fffffffu, 0x7fffe000u, // Infinity and NaNs
+        };
+        for (auto bits : edges) {
+            for (auto sign : {0u, 0x80000000u}) {
+                const float value = fromBits(bits | sign);
+                INFO("float bits " << std::hex << (bits | sign));
+                REQUIRE(sameHalf(graphics::toHalf(value), referenceHalf(value)));
+            }
+        }
+    }
+
+    SECTION("across the whole float range") {
+        // A prime stride visits every exponent with varied mantissas, the full 2^32 sweep takes too long for a test
+        std::size_t mismatches = 0;
+        std::uint32_t first_mismatch = 0;
+        for (std::uint64_t bits = 0; bits <= 0xffffffffull; bits += 257) {
+            const float value = fromBits(std::uint32_t(bits));
+            if (! sameHalf(graphics::toHalf(value), referenceHalf(value))) {
+                first_mismatch = mismatches++ ? first_mismatch : std::uint32_t(bits);
+            }
+        }
+        INFO("first mismatch at float bits " << std::hex << first_mismatch);
+        REQUIRE(mismatches == 0);
+    }
+}
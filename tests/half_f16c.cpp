@@ -0,0 +1,9 @@
+#include <cstdint>
+
+#include <immintrin.h>
+
+// Compiled with F16C enabled, only call it after checking cpu::hasF16C()
+std::uint16_t referenceHalf (float value)
+{
+    return std::uint16_t(_cvtss_sh(value, _MM_FROUND_TO_NEAREST_INT));
+}
@@ -0,0 +1,109 @@
+#include "catch.hpp"
+
+#include <atomic>
+#include <memory>
+
+#include "jobs/scheduler.h"
+
+namespace {
+
+// Counts how often each index was visited
+struct Visits {
+    explicit Visits (std::size_t count) : counts(new std::atomic<int>[count]), count(count) {
+        for (std::size_t index = 0; index < count; ++index) {
+            counts[index] = 0;
+        }
+    }
+
+    void visit (std::size_t begin, std::size_t end) {
+        for (std::size_t index = begin; index < end; ++index) {
+            counts[index].fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // Index of the first entry not visited exactly once, or count if there is none
+    std::size_t firstWrong () const {
+        for (std::size_t index = 0; index < count; ++index) {
+            if (counts[index] != 1) {
+                return index;
+            }
+        }
+        return count;
+    }
+
+    std::unique_ptr<std::atomic<int>[]> counts;
+    std::size_t count;
+};
+
+struct Tree {
+    jobs::Scheduler& scheduler;
+    jobs::Counter& counter;
+    std::atomic<std::size_t> leaves{0};
+};
+
+// Splits its range in two until it is a single leaf, submitting both halves against the tree's counter
+void split (void* data, std::size_t begin, std::size_t end)
+{
+    auto& tree = *static_cast<Tree*>(data);
+    if (end - begin == 1) {
+        tree.leaves.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    const std::size_t middle = begin + (end - begin) / 2;
+    tree.scheduler.submit({split, data, begin, middle, &tree.counter});
+    tree.scheduler.submit({split, data, middle, end, &tree.counter});
+}
+
+}
+
+TEST_CASE("parallelFor visits every index exactly once", "[jobs]")
+{
+    for (std::size_t workers : {1, 2, 4}) {
+        jobs::Scheduler scheduler;
+        scheduler.init(workers);
+        // A grain size of 1 over 5000 indices submits more jobs than a deque holds, so some of them run inline
+        for (std::size_t count : {0, 1, 7, 64, 65, 1000, 5000}) {
+            for (std::size_t grain_size : {0, 1, 16, 64, 10000}) {
+                INFO(workers << " workers, " << count << " indices, grain size " << grain_size);
+                Visits visits(count);
+                scheduler.parallelFor(count, grain_size, [&](std::size_t begin, std::size_t end){
+                    visits.visit(begin, end);
+                });
+                REQUIRE(visits.firstWrong() == count);
+            }
+        }
+        scheduler.term();
+    }
+}
+
+TEST_CASE("Nested parallelFor completes", "[jobs]")
+{
+    jobs::Scheduler scheduler;
+    scheduler.init(4);
+    constexpr std::size_t Outer = 32;
+    constexpr std::size_t Inner = 500;
+    Visits visits(Outer * Inner);
+    scheduler.parallelFor(Outer, 1, [&](std::size_t begin, std::size_t end){
+        for (std::size_t outer = begin; outer < end; ++outer) {
+            scheduler.parallelFor(Inner, 16, [&](std::size_t inner_begin, std::size_t inner_end){
+                visits.visit(outer * Inner + inner_begin, outer * Inner + inner_end);
+            });
+        }
+    });
+    REQUIRE(visits.firstWrong() == Outer * Inner);
+    scheduler.term();
+}
+
+TEST_CASE("Waiting on a counter includes jobs submitted by its jobs", "[jobs]")
+{
+    jobs::Scheduler scheduler;
+    scheduler.init(4);
+    jobs::Counter counter;
+    Tree tree{scheduler, counter};
+    constexpr std::size_t Leaves = 4096;
+    scheduler.submit({split, &tree, 0, Leaves, &counter});
+    scheduler.wait(counter);
+    REQUIRE(tree.leaves == Leaves);
+    REQUIRE(counter.pending == 0);
+    scheduler.term();
+}
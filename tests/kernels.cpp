@@ -0,0 +1,215 @@
+#include "catch.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "ecs/components/bitmap_animation.h"
+#include "ecs/components/kinematic_body.h"
+#include "ecs/components/position.h"
+#include "ecs/components/sprite.h"
+#include "ecs/systems/kinematic_integration_kernels.h"
+#include "ecs/systems/sprite_animation_kernels.h"
+#include "graphics/culling.h"
+#include "util/cpu.h"
+
+namespace {
+
+// Counts around each kernel's width, so that every length of remainder is handed to the scalar kernel
+const std::size_t Counts[] = {0, 1, 2, 3, 4, 5, 7, 8, 9, 12, 15, 16, 17, 23, 31, 33, 1001};
+
+template <typename Fn>
+struct Kernel {
+    const char* name;
+    Fn fn;
+    bool supported;
+};
+
+template <typename Fn>
+std::vector<Kernel<Fn>> simdKernels (Fn sse41, Fn avx2)
+{
+    return {{"sse4.1", sse41, cpu::hasSSE41()}, {"avx2", avx2, cpu::hasAVX2()}};
+}
+
+using graphics::culling::SpriteFloats;
+
+// Axis aligned box from -10 to 10 on every axis, normals pointing inwards
+const float BoxPlanes[6 * 4] = {
+     1,  0,  0, 10,
+    -1,  0,  0, 10,
+     0,  1,  0, 10,
+     0, -1,  0, 10,
+     0,  0,  1, 10,
+     0,  0, -1, 10,
+};
+constexpr float Radius = 1.0f;
+
+// Sprites scattered so that about half of them are visible, with their index as the image to identify them
+std::vector<float> scatterSprites (std::size_t count, std::mt19937& mt)
+{
+    std::uniform_real_distribution<float> dist(-14.0f, 14.0f);
+    std::vector<float> sprites(count * SpriteFloats);
+    for (std::size_t index = 0; index < count; ++index) {
+        sprites[index * SpriteFloats + 0] = dist(mt);
+        sprites[index * SpriteFloats + 1] = dist(mt);
+        sprites[index * SpriteFloats + 2] = dist(mt);
+        sprites[index * SpriteFloats + 3] = float(index);
+    }
+    return sprites;
+}
+
+bool visible (const float* sprite)
+{
+    for (std::size_t axis = 0; axis < 3; ++axis) {
+        if (std::fabs(sprite[axis]) >= 10.0f + Radius) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
+TEST_CASE("Culling keeps visible sprites in their original order", "[graphics][culling]")
+{
+    std::mt19937 mt(0);
+    std::vector<Kernel<graphics::culling::cull_fn>> kernels = {{"scalar", graphics::culling::cull_scalar, true}};
+    for (const auto& kernel : simdKernels(graphics::culling::cull_sse41, graphics::culling::cull_avx2)) {
+        kernels.push_back(kernel);
+    }
+    for (const auto& kernel : kernels) {
+        if (! kernel.supported) {
+            WARN(kernel.name << " is not supported by this CPU");
+            continue;
+        }
+        for (std::size_t count : Counts) {
+            INFO(kernel.name << " kernel, " << count << " sprites");
+            const auto sprites = scatterSprites(count, mt);
+            std::vector<float> expected;
+            for (std::size_t index = 0; index < count; ++index) {
+                if (visible(&sprites[index * SpriteFloats])) {
+                    expected.insert(expected.end(), &sprites[index * SpriteFloats], &sprites[(index + 1) * SpriteFloats]);
+                }
+            }
+            const std::size_t expected_count = expected.size() / SpriteFloats;
+
+            std::vector<float> out(sprites.size());
+            REQUIRE(kernel.fn(BoxPlanes, Radius, sprites.data(), count, out.data()) == expected_count);
+            REQUIRE(std::memcmp(out.data(), expected.data(), expected.size() * sizeof(float)) == 0);
+
+            // Compacting in place has to give the same result
+            auto in_place = sprites;
+            REQUIRE(kernel.fn(BoxPlanes, Radius, in_place.data(), count, in_place.data()) == expected_count);
+            REQUIRE(std::memcmp(in_place.data(), expected.data(), expected.size() * sizeof(float)) == 0);
+        }
+    }
+}
+
+TEST_CASE("SIMD culling kernels agree with the scalar kernel", "[graphics][culling]")
+{
+    std::mt19937 mt(1);
+    for (const auto& kernel : simdKernels(graphics::culling::cull_sse41, graphics::culling::cull_avx2)) {
+        if (! kernel.supported) {
+            WARN(kernel.name << " is not supported by this CPU");
+            continue;
+        }
+        for (std::size_t count : Counts) {
+            INFO(kernel.name << " kernel, " << count << " sprites");
+            auto sprites = scatterSprites(count, mt);
+            // Put some sprites exactly on the boundary, where a sphere only just touches a plane
+            for (std::size_t index = 0; index < count; index += 3) {
+                sprites[index * SpriteFloats] = index % 2 ? 11.0f : -11.0f;
+            }
+            std::vector<float> expected(sprites.size()), out(sprites.size());
+            const auto expected_count = graphics::culling::cull_scalar(BoxPlanes, Radius, sprites.data(), count, expected.data());
+            REQUIRE(kernel.fn(BoxPlanes, Radius, sprites.data(), count, out.data()) == expected_count);
+            REQUIRE(std::memcmp(out.data(), expected.data(), expected_count * SpriteFloats * sizeof(float)) == 0);
+        }
+    }
+}
+
+TEST_CASE("SIMD sprite animation kernels agree with the scalar kernel", "[ecs][sprite_animation]")
+{
+    using ecs::components::bitmap_animation;
+    using ecs::components::sprite;
+    std::mt19937 mt(2);
+    std::uniform_real_distribution<float> speed(0.01f, 0.2f);
+    std::uniform_int_distribution<int> frames(1, 8);
+    for (const auto& kernel : simdKernels(ecs::systems::kernels::animate_sse41, ecs::systems::kernels::animate_avx2)) {
+        if (! kernel.supported) {
+            WARN(kernel.name << " is not supported by this CPU");
+            continue;
+        }
+        for (std::size_t count : Counts) {
+            INFO(kernel.name << " kernel, " << count << " animations");
+            std::vector<bitmap_animation> animations(count);
+            for (std::size_t index = 0; index < count; ++index) {
+                const float max_frames = float(frames(mt));
+                animations[index] = {float(index * 8), max_frames, speed(mt), float(index % int(max_frames)), 0.0f};
+            }
+            auto expected_animations = animations;
+            std::vector<sprite> expected_sprites(count), sprites(count);
+            // Enough steps for every animation to wrap around a few times
+            for (int step = 0; step < 100; ++step) {
+                ecs::systems::kernels::animate_scalar(1.0f / 60.0f, expected_animations.data(), expected_sprites.data(), count);
+                kernel.fn(1.0f / 60.0f, animations.data(), sprites.data(), count);
+            }
+            for (std::size_t index = 0; index < count; ++index) {
+                INFO("animation " << index);
+                REQUIRE(animations[index].current_frame == expected_animations[index].current_frame);
+                REQUIRE(animations[index].frame_time == expected_animations[index].frame_time);
+                REQUIRE(sprites[index].image == expected_sprites[index].image);
+            }
+        }
+    }
+}
+
+TEST_CASE("SIMD kinematic integration kernels agree with the scalar kernel", "[ecs][kinematic_integration]")
+{
+    using ecs::components::kinematic_body;
+    using ecs::components::position;
+    const ecs::systems::kernels::kinematic_step step{1.0f / 60.0f, -10.0f, 0.0f, -20.0f, 20.0f, -20.0f, 20.0f};
+    std::mt19937 mt(3);
+    std::uniform_real_distribution<float> dist(-20.0f, 20.0f);
+    auto integrate = [&](ecs::systems::kernels::integrate_fn fn, std::vector<kinematic_body>& bodies, std::vector<position>& positions) {
+        if (! bodies.empty()) {
+            fn(step, &bodies[0].velocity.x, sizeof(kinematic_body) / sizeof(float), &positions[0].position.x, sizeof(position) / sizeof(float), bodies.size());
+        }
+    };
+    for (const auto& kernel : simdKernels(ecs::systems::kernels::integrate_sse41, ecs::systems::kernels::integrate_avx2)) {
+        if (! kernel.supported) {
+            WARN(kernel.name << " is not supported by this CPU");
+            continue;
+        }
+        for (std::size_t count : Counts) {
+            INFO(kernel.name << " kernel, " << count << " bodies");
+            std::vector<kinematic_body> bodies(count);
+            std::vector<position> positions(count);
+            for (std::size_t index = 0; index < count; ++index) {
+                bodies[index].velocity = glm::vec3(dist(mt), dist(mt), dist(mt));
+                bodies[index].restitution = 0.5f;
+                positions[index].position = glm::vec3(dist(mt), std::fabs(dist(mt)), dist(mt));
+                positions[index].previous = glm::vec3(float(index));
+            }
+            auto expected_bodies = bodies;
+            auto expected_positions = positions;
+            // Long enough for bodies to bounce off the ground and the bounds
+            for (int frame = 0; frame < 120; ++frame) {
+                integrate(ecs::systems::kernels::integrate_scalar, expected_bodies, expected_positions);
+                integrate(kernel.fn, bodies, positions);
+            }
+            for (std::size_t index = 0; index < count; ++index) {
+                INFO("body " << index);
+                // Kernels may contract multiplies and adds differently, so allow for rounding
+                for (int axis = 0; axis < 3; ++axis) {
+                    REQUIRE(positions[index].position[axis] == Approx(expected_positions[index].position[axis]).margin(1e-3));
+                    REQUIRE(bodies[index].velocity[axis] == Approx(expected_bodies[index].velocity[axis]).margin(1e-3));
+                }
+                REQUIRE(bodies[index].restitution == 0.5f);
+                // The SIMD kernels store four floats per position, the fourth one has to come back untouched
+                REQUIRE(positions[index].previous.x == float(index));
+            }
+        }
+    }
+}
@@ -0,0 +1,272 @@
+#include "catch.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "jobs/scheduler.h"
+#include "physics/engine.h"
+#include "services/locator.h"
+
+namespace {
+
+// Single threaded engine with no level, stepping at 60Hz
+struct EngineFixture {
+    EngineFixture (physics::Broadphase broadphase = physics::Broadphase::Dbvt) {
+        services::locator::config<"physics.threads"_hs, int>(1);
+        services::locator::config<"physics.rate"_hs, float>(60.0f);
+        services::locator::config<"physics.max-substeps"_hs, int>(1);
+        services::locator::config<"physics.broadphase"_hs, int>(int(broadphase));
+        services::locator::config<"physics.world-size"_hs, float>(1000.0f);
+        engine.init();
+    }
+    ~EngineFixture () {
+        engine.term();
+    }
+
+    void add (ecs::entity entity, const glm::vec3& position, const glm::vec3& half_extents = glm::vec3(0.5f)) {
+        engine.addBody(entity, {position, 1.0f, 0.5f, 0.0f}, {half_extents});
+    }
+
+    physics::Engine engine;
+};
+
+// Bodies for the query tests, with workers so that queries on the dbvt broadphase are spread across them
+struct QueryFixture : EngineFixture {
+    // More bodies than an overlap query keeps, in a cluster of rows starting at ClusterZ
+    static constexpr std::size_t ClusterSize = services::Physics::MaxOverlaps + 4;
+    static constexpr float ClusterZ = 50.0f;
+    // Enough queries for several batches
+    static constexpr std::size_t Repeats = 300;
+
+    QueryFixture (physics::Broadphase broadphase = physics::Broadphase::Dbvt) : EngineFixture(broadphase) {
+        auto scheduler = std::make_shared<jobs::Scheduler>();
+        scheduler->init(4);
+        services::locator::scheduler::set(scheduler);
+
+        // Two boxes in a row along the x axis
+        near_box = registry.create();
+        far_box = registry.create();
+        add(near_box, glm::vec3(5.0f, 0.0f, 0.0f));
+        add(far_box, glm::vec3(10.0f, 0.0f, 0.0f));
+        for (std::size_t index = 0; index < ClusterSize; ++index) {
+            cluster.push_back(registry.create());
+            add(cluster.back(), glm::vec3(float(index % 5) * 1.5f - 3.0f, 0.0f, ClusterZ + float(index / 5) * 1.5f));
+        }
+    }
+    ~QueryFixture () {
+        services::locator::scheduler::ref().term();
+        services::locator::scheduler::reset();
+    }
+
+    ecs::registry_type registry;
+    ecs::entity near_box;
+    ecs::entity far_box;
+    std::vector<ecs::entity> cluster;
+};
+
+struct AxisSweepQueryFixture : QueryFixture {
+    AxisSweepQueryFixture () : QueryFixture(physics::Broadphase::AxisSweep) {}
+};
+
+// The same queries for every broadphase: dbvt searches its trees directly from the workers, the others search through
+// the broadphase's own interface on the calling thread
+void runQueries (QueryFixture& fixture)
+{
+    auto& engine = fixture.engine;
+    const std::size_t repeats = QueryFixture::Repeats;
+
+    SECTION("a ray hits the nearest body along it") {
+        const std::vector<services::Physics::Ray> rays = {
+            {glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(20.0f, 0.0f, 0.0f)},
+            {glm::vec3(20.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 0.0f)},
+        };
+        std::vector<services::Physics::Ray> queries;
+        for (std::size_t index = 0; index < repeats; ++index) {
+            queries.push_back(rays[index % 2]);
+        }
+        std::vector<services::Physics::RayHit> hits(queries.size());
+        engine.raycast({queries.data(), queries.size()}, {hits.data(), hits.size()});
+        for (std::size_t index = 0; index < repeats; ++index) {
+            INFO("ray " << index);
+            const auto& hit = hits[index];
+            REQUIRE(hit.hit);
+            if (index % 2 == 0) {
+                REQUIRE(hit.entity == fixture.near_box);
+                REQUIRE(hit.position.x == Approx(4.5f).margin(0.05f));
+                REQUIRE(hit.normal.x == Approx(-1.0f));
+                REQUIRE(hit.fraction == Approx(4.5f / 20.0f).margin(0.01f));
+            } else {
+                REQUIRE(hit.entity == fixture.far_box);
+                REQUIRE(hit.position.x == Approx(10.5f).margin(0.05f));
+                REQUIRE(hit.normal.x == Approx(1.0f));
+                REQUIRE(hit.fraction == Approx(9.5f / 20.0f).margin(0.01f));
+            }
+        }
+    }
+
+    SECTION("a ray that misses leaves no trace of earlier hits") {
+        const std::vector<services::Physics::Ray> rays(repeats, {glm::vec3(0.0f, 5.0f, 0.0f), glm::vec3(20.0f, 5.0f, 0.0f)});
+        std::vector<services::Physics::RayHit> hits(repeats, {fixture.near_box, glm::vec3(1.0f), glm::vec3(1.0f), 0.5f, true});
+        engine.raycast({rays.data(), rays.size()}, {hits.data(), hits.size()});
+        for (const auto& hit : hits) {
+            REQUIRE_FALSE(hit.hit);
+            REQUIRE(hit.entity == ecs::entity(entt::null));
+            REQUIRE(hit.position == glm::vec3(0.0f));
+            REQUIRE(hit.normal == glm::vec3(0.0f));
+            REQUIRE(hit.fraction == 1.0f);
+        }
+    }
+
+    SECTION("an overlap counts every body but keeps only the first MaxOverlaps") {
+        const glm::vec3 center(0.0f, 0.0f, QueryFixture::ClusterZ + 3.0f);
+        const std::vector<services::Physics::Sphere> spheres(repeats, {center, 10.0f});
+        const std::vector<services::Physics::Box> boxes(repeats, {center, glm::vec3(10.0f)});
+        std::vector<services::Physics::Overlaps> sphere_results(repeats), box_results(repeats);
+        engine.overlap(ecs::span<const services::Physics::Sphere>(spheres.data(), spheres.size()), {sphere_results.data(), sphere_results.size()});
+        engine.overlap(ecs::span<const services::Physics::Box>(boxes.data(), boxes.size()), {box_results.data(), box_results.size()});
+        for (const auto& results : {sphere_results, box_results}) {
+            for (const auto& result : results) {
+                REQUIRE(result.count == QueryFixture::ClusterSize);
+                std::vector<ecs::entity> kept(result.entities.begin(), result.entities.end());
+                std::sort(kept.begin(), kept.end());
+                REQUIRE(std::unique(kept.begin(), kept.end()) == kept.end());
+                for (auto entity : kept) {
+                    REQUIRE(std::find(fixture.cluster.begin(), fixture.cluster.end(), entity) != fixture.cluster.end());
+                }
+            }
+        }
+    }
+
+    SECTION("a sphere overlap ignores bodies that only touch its bounding box") {
+        // Inside the near box's bounding box on x and z, but more than the radius away from its corner
+        const std::vector<services::Physics::Sphere> spheres = {{glm::vec3(6.3f, 0.0f, 1.3f), 1.0f}, {glm::vec3(6.0f, 0.0f, 0.0f), 1.0f}};
+        std::vector<services::Physics::Overlaps> results(spheres.size());
+        engine.overlap(ecs::span<const services::Physics::Sphere>(spheres.data(), spheres.size()), {results.data(), results.size()});
+        REQUIRE(results[0].count == 0);
+        REQUIRE(results[1].count == 1);
+        REQUIRE(results[1].entities[0] == fixture.near_box);
+    }
+
+    SECTION("nearest finds the closest body within the radius") {
+        const std::vector<services::Physics::Sphere> spheres = {
+            {glm::vec3(5.2f, 0.0f, 0.0f), 3.0f},
+            {glm::vec3(9.0f, 0.0f, 0.0f), 3.0f},
+            {glm::vec3(0.0f, 20.0f, 0.0f), 1.0f},
+        };
+        std::vector<services::Physics::Sphere> queries;
+        for (std::size_t index = 0; index < repeats; ++index) {
+            queries.push_back(spheres[index % spheres.size()]);
+        }
+        std::vector<services::Physics::Nearest> results(queries.size());
+        engine.nearest({queries.data(), queries.size()}, {results.data(), results.size()});
+        for (std::size_t index = 0; index < repeats; ++index) {
+            INFO("sphere " << index);
+            const auto& result = results[index];
+            switch (index % spheres.size()) {
+                case 0:
+                    REQUIRE(result.found);
+                    REQUIRE(result.entity == fixture.near_box);
+                    REQUIRE(result.distance == Approx(0.2f).margin(0.01f));
+                    break;
+                case 1:
+                    REQUIRE(result.found);
+                    REQUIRE(result.entity == fixture.far_box);
+                    REQUIRE(result.distance == Approx(1.0f).margin(0.01f));
+                    break;
+                default:
+                    REQUIRE_FALSE(result.found);
+                    break;
+            }
+        }
+    }
+}
+
+}
+
+TEST_CASE_METHOD(EngineFixture, "The body table rejects entities whose version is stale", "[physics]")
+{
+    ecs::registry_type registry;
+    const auto stale = registry.create();
+    registry.destroy(stale);
+    // Same index as stale, but a newer version
+    const auto current = registry.create();
+    REQUIRE(ecs::entity_index(current) == ecs::entity_index(stale));
+    REQUIRE(current != stale);
+
+    add(current, glm::vec3(3.0f, 5.0f, 7.0f));
+    REQUIRE(engine.liveBodies() == 1);
+
+    SECTION("when looking up a body") {
+        const glm::vec3 untouched(-1.0f);
+        glm::vec3 position = untouched;
+        engine.getBodyPosition(stale, position);
+        REQUIRE(position.x == untouched.x);
+        REQUIRE(position.y == untouched.y);
+        REQUIRE(position.z == untouched.z);
+
+        engine.getBodyPosition(current, position);
+        REQUIRE(position.x == Approx(3.0f));
+        REQUIRE(position.y == Approx(5.0f));
+        REQUIRE(position.z == Approx(7.0f));
+    }
+
+    SECTION("when removing a body") {
+        engine.removeBody(stale);
+        REQUIRE(engine.liveBodies() == 1);
+        engine.removeBodies({stale});
+        REQUIRE(engine.liveBodies() == 1);
+        engine.removeBody(current);
+        REQUIRE(engine.liveBodies() == 0);
+    }
+
+    SECTION("when the index is reused before its body was removed") {
+        registry.destroy(current);
+        const auto reused = registry.create();
+        REQUIRE(ecs::entity_index(reused) == ecs::entity_index(current));
+        add(reused, glm::vec3(0.0f, 10.0f, 0.0f));
+        // The old body is replaced rather than leaked, and only answers to the new version
+        REQUIRE(engine.liveBodies() == 1);
+        engine.removeBody(current);
+        REQUIRE(engine.liveBodies() == 1);
+        engine.removeBody(reused);
+        REQUIRE(engine.liveBodies() == 0);
+    }
+}
+
+TEST_CASE_METHOD(EngineFixture, "Shapes are shared and freed once their last body is removed", "[physics]")
+{
+    ecs::registry_type registry;
+    std::vector<ecs::entity> small, large;
+    for (int index = 0; index < 3; ++index) {
+        small.push_back(registry.create());
+        large.push_back(registry.create());
+        add(small.back(), glm::vec3(float(index) * 3.0f, 1.0f, 0.0f));
+        add(large.back(), glm::vec3(float(index) * 3.0f, 1.0f, 10.0f), glm::vec3(1.0f));
+    }
+    REQUIRE(engine.liveBodies() == 6);
+    REQUIRE(engine.liveShapes() == 2);
+
+    engine.removeBodies({small[0], small[1]});
+    REQUIRE(engine.liveShapes() == 2);
+    engine.removeBody(small[2]);
+    REQUIRE(engine.liveShapes() == 1);
+
+    // A freed shape is created again when a body needs it
+    add(small[0], glm::vec3(0.0f, 1.0f, 0.0f));
+    REQUIRE(engine.liveShapes() == 2);
+
+    engine.removeBodies({small[0], large[0], large[1], large[2]});
+    REQUIRE(engine.liveBodies() == 0);
+    REQUIRE(engine.liveShapes() == 0);
+}
+
+TEST_CASE_METHOD(QueryFixture, "Queries on the dbvt broadphase", "[physics][queries]")
+{
+    runQueries(*this);
+}
+
+TEST_CASE_METHOD(AxisSweepQueryFixture, "Queries on the axis sweep broadphase", "[physics][queries]")
+{
+    runQueries(*this);
+}